@@ -0,0 +1,202 @@
+// SPDX-FileCopyrightText: 2022 Amyspark <amy@amyspark.me>
+// SPDX-License-Identifier: BSD-3-Clause
+
+#include "ycbcr_arena.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+
+namespace ycbcr
+{
+namespace
+{
+// Every allocation is preceded by its size, padded so that the allocation
+// itself stays aligned as malloc's would be.
+constexpr size_t alignment = alignof(std::max_align_t);
+constexpr size_t headerSize = (sizeof(size_t) + alignment - 1) / alignment * alignment;
+
+constexpr size_t padded(size_t size)
+{
+    return (size + alignment - 1) / alignment * alignment;
+}
+
+size_t &sizeOf(void *ptr)
+{
+    return *reinterpret_cast<size_t *>(static_cast<unsigned char *>(ptr) - headerSize);
+}
+
+Arena &arenaOf(cmsContext ctx)
+{
+    return *static_cast<Arena *>(cmsGetContextUserData(ctx));
+}
+} // namespace
+
+Arena::Arena(cmsLogErrorHandlerFunction log, const std::vector<cmsPluginBase *> &plugins, size_t blockSize)
+    : log(log)
+    , plugins(plugins)
+    , blockSize(padded(std::max(blockSize, 2 * headerSize)))
+{
+    createContext();
+}
+
+Arena::~Arena()
+{
+    if (ctx) {
+        cmsDeleteContext(ctx);
+    }
+    for (const auto &block : blocks) {
+        std::free(block.data);
+    }
+}
+
+cmsContext Arena::context() const
+{
+    return ctx;
+}
+
+bool Arena::reset()
+{
+    if (ctx) {
+        cmsDeleteContext(ctx);
+        ctx = nullptr;
+    }
+    {
+        const std::lock_guard<std::mutex> lock(mutex);
+        for (auto &block : blocks) {
+            block.used = 0;
+        }
+        current = 0;
+        const auto reserved = counters.reservedBytes;
+        counters = {};
+        counters.reservedBytes = reserved;
+    }
+    return createContext();
+}
+
+ArenaStats Arena::stats() const
+{
+    const std::lock_guard<std::mutex> lock(mutex);
+    return counters;
+}
+
+bool Arena::createContext()
+{
+    static cmsPluginMemHandler handler = {{cmsPluginMagicNumber, 2000, cmsPluginMemHandlerSig, nullptr}, mallocHandler, freeHandler, reallocHandler, nullptr, nullptr, nullptr};
+
+    ctx = cmsCreateContext(&handler, this);
+    if (!ctx) {
+        return false;
+    }
+    if (log) {
+        cmsSetLogErrorHandlerTHR(ctx, log);
+    }
+    for (auto *plugin : plugins) {
+        if (!cmsPluginTHR(ctx, plugin)) {
+            cmsDeleteContext(ctx);
+            ctx = nullptr;
+            return false;
+        }
+    }
+    return true;
+}
+
+void *Arena::mallocHandler(cmsContext ctx, cmsUInt32Number size)
+{
+    return arenaOf(ctx).allocate(size);
+}
+
+void Arena::freeHandler(cmsContext ctx, void *ptr)
+{
+    arenaOf(ctx).release(ptr);
+}
+
+void *Arena::reallocHandler(cmsContext ctx, void *ptr, cmsUInt32Number size)
+{
+    return arenaOf(ctx).reallocate(ptr, size);
+}
+
+void *Arena::allocate(size_t size)
+{
+    const std::lock_guard<std::mutex> lock(mutex);
+    const auto needed = headerSize + padded(size);
+
+    // Move on to the first block with enough room left, or to a new one,
+    // big enough for this allocation alone if need be.
+    while (current < blocks.size() && blocks[current].size - blocks[current].used < needed) {
+        current++;
+    }
+    if (current == blocks.size()) {
+        const auto bytes = std::max(blockSize, needed);
+        auto *data = static_cast<unsigned char *>(std::malloc(bytes));
+        if (!data) {
+            current = blocks.empty() ? 0 : blocks.size() - 1;
+            return nullptr;
+        }
+        blocks.push_back({data, bytes, 0});
+        counters.reservedBytes += bytes;
+    }
+
+    auto &block = blocks[current];
+    auto *ptr = block.data + block.used + headerSize;
+    block.used += needed;
+    sizeOf(ptr) = size;
+
+    counters.allocations++;
+    counters.liveBytes += size;
+    counters.peakBytes = std::max(counters.peakBytes, counters.liveBytes);
+    return ptr;
+}
+
+void Arena::release(void *ptr)
+{
+    if (!ptr) {
+        return;
+    }
+    const std::lock_guard<std::mutex> lock(mutex);
+    const auto size = sizeOf(ptr);
+    counters.frees++;
+    counters.liveBytes -= size;
+
+    // The most recent allocation can be given back.
+    auto &block = blocks[current];
+    if (static_cast<unsigned char *>(ptr) + padded(size) == block.data + block.used) {
+        block.used -= headerSize + padded(size);
+    }
+}
+
+void *Arena::reallocate(void *ptr, size_t size)
+{
+    if (!ptr) {
+        return allocate(size);
+    }
+    {
+        const std::lock_guard<std::mutex> lock(mutex);
+        auto &oldSize = sizeOf(ptr);
+        auto &block = blocks[current];
+        // The most recent allocation can grow or shrink in place.
+        const auto end = static_cast<unsigned char *>(ptr) + padded(oldSize);
+        if (end == block.data + block.used && static_cast<unsigned char *>(ptr) + padded(size) <= block.data + block.size) {
+            block.used = static_cast<size_t>(static_cast<unsigned char *>(ptr) + padded(size) - block.data);
+            counters.reallocations++;
+            counters.liveBytes = counters.liveBytes - oldSize + size;
+            counters.peakBytes = std::max(counters.peakBytes, counters.liveBytes);
+            oldSize = size;
+            return ptr;
+        }
+    }
+
+    auto *moved = allocate(size);
+    if (!moved) {
+        return nullptr;
+    }
+    const std::lock_guard<std::mutex> lock(mutex);
+    const auto oldSize = sizeOf(ptr);
+    std::memcpy(moved, ptr, std::min(oldSize, size));
+    // Counted as a reallocation only.
+    counters.allocations--;
+    counters.reallocations++;
+    counters.liveBytes -= oldSize;
+    return moved;
+}
+} // namespace ycbcr
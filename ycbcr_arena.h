@@ -0,0 +1,88 @@
+// SPDX-FileCopyrightText: 2022 Amyspark <amy@amyspark.me>
+// SPDX-License-Identifier: BSD-3-Clause
+
+#pragma once
+
+#include <lcms2.h>
+#include <lcms2_plugin.h>
+
+#include <cstddef>
+#include <mutex>
+#include <vector>
+
+namespace ycbcr
+{
+constexpr size_t defaultArenaBlockSize = 256 * 1024;
+
+struct ArenaStats {
+    // Calls to the allocation functions since the last reset. A realloc of
+    // nullptr counts as an allocation.
+    size_t allocations = 0;
+    size_t reallocations = 0;
+    size_t frees = 0;
+    // Bytes requested and not yet freed, and their maximum.
+    size_t liveBytes = 0;
+    size_t peakBytes = 0;
+    // Bytes taken from the system, kept across resets.
+    size_t reservedBytes = 0;
+};
+
+// A context whose allocations are carved out of large blocks, through a
+// memory handler plugin, and released all at once.
+//
+// Freeing is a no-op, except for the most recent allocation, so anything
+// created in the context (profiles, transforms, pipelines...) can be
+// dropped without freeing it. reset() throws everything away, and starts
+// over with a new context that reuses the same blocks.
+//
+// The context's user data points to the arena. Allocations are serialized
+// by a mutex, so the context can be used from several threads, but the
+// intended use is one arena per thread.
+class Arena
+{
+public:
+    // log and plugins are installed in the context, and again after each
+    // reset.
+    explicit Arena(cmsLogErrorHandlerFunction log = nullptr, const std::vector<cmsPluginBase *> &plugins = {}, size_t blockSize = defaultArenaBlockSize);
+    ~Arena();
+
+    Arena(const Arena &) = delete;
+    Arena &operator=(const Arena &) = delete;
+
+    // nullptr if the context (or a plugin) couldn't be set up.
+    cmsContext context() const;
+
+    // Releases every allocation, invalidating whatever was created in the
+    // context, and the context itself. Returns false if the new context
+    // couldn't be set up.
+    bool reset();
+
+    ArenaStats stats() const;
+
+private:
+    struct Block {
+        unsigned char *data;
+        size_t size;
+        size_t used;
+    };
+
+    static void *mallocHandler(cmsContext ctx, cmsUInt32Number size);
+    static void freeHandler(cmsContext ctx, void *ptr);
+    static void *reallocHandler(cmsContext ctx, void *ptr, cmsUInt32Number size);
+
+    void *allocate(size_t size);
+    void release(void *ptr);
+    void *reallocate(void *ptr, size_t size);
+    bool createContext();
+
+    cmsLogErrorHandlerFunction log;
+    std::vector<cmsPluginBase *> plugins;
+    size_t blockSize;
+    mutable std::mutex mutex;
+    std::vector<Block> blocks;
+    // The block being carved.
+    size_t current = 0;
+    ArenaStats counters;
+    cmsContext ctx = nullptr;
+};
+} // namespace ycbcr
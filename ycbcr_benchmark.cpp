@@ -0,0 +1,876 @@
+// SPDX-FileCopyrightText: 2022 Amyspark <amy@amyspark.me>
+// SPDX-License-Identifier: BSD-3-Clause
+
+#include <lcms2.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "ycbcr_arena.h"
+#include "ycbcr_convert.h"
+#include "ycbcr_flags.h"
+#include "ycbcr_lcms_plugins.h"
+#include "ycbcr_optimization.h"
+#include "ycbcr_profile.h"
+#include "ycbcr_reference.h"
+
+namespace
+{
+using clock = std::chrono::steady_clock;
+
+struct Format {
+    const char *name;
+    cmsUInt32Number yCbCr;
+    cmsUInt32Number rgb;
+    size_t bytesPerPixel;
+};
+
+const std::vector<Format> formats = {
+    {"8", TYPE_YCbCr_8, TYPE_RGB_8, 3 * sizeof(cmsUInt8Number)},
+    {"16", TYPE_YCbCr_16, TYPE_RGB_16, 3 * sizeof(cmsUInt16Number)},
+    {"FLT", TYPE_YCbCr_FLT, TYPE_RGB_FLT, 3 * sizeof(cmsFloat32Number)},
+};
+
+struct Size {
+    cmsUInt32Number width;
+    cmsUInt32Number height;
+};
+
+// One thread, and all the cores.
+std::vector<unsigned int> defaultThreads()
+{
+    const auto cores = std::thread::hardware_concurrency();
+    if (cores > 1) {
+        return {1, cores};
+    }
+    return {1};
+}
+
+struct Options {
+    std::vector<Size> sizes{{256, 256}, {1280, 720}, {1920, 1080}};
+    std::vector<unsigned int> threads = defaultThreads();
+    // Minimum time spent transforming frames, per measurement.
+    std::chrono::milliseconds minimumDuration{100};
+    // Number of transforms created to measure the latency.
+    size_t creations = 3;
+    // Register the YCbCr optimization plugin.
+    bool plugin = false;
+    // LittleCMS' own plugins to register.
+    std::vector<ycbcr::LcmsPlugin> lcmsPlugins;
+    // Create each transform in a fresh arena, and report its allocations.
+    bool arena = false;
+    // Measure every combination of transform flags instead.
+    bool flags = false;
+    // Measure and check ycbcr::Converter instead.
+    bool converter = false;
+    std::vector<ycbcr::Display> destinations{ycbcr::Display::SRGB};
+    // Where to write the recommended flags, if anywhere.
+    std::string recommend;
+    std::string output;
+    std::vector<std::string> profiles;
+};
+
+void log(cmsContext ctx, unsigned int errorCode, const char *msg)
+{
+    std::cerr << "context " << ctx << " error: " << errorCode << " (" << msg << ")" << std::endl;
+}
+
+void usage(const char *argv0)
+{
+    std::cerr << "Usage: " << argv0 << " [options] PROFILE...\n"
+              << "\n"
+              << "Measures the creation latency and throughput of YCbCr <-> sRGB transforms\n"
+              << "for each profile, in 8-bit, 16-bit and floating point.\n"
+              << "\n"
+              << "  --sizes LIST     comma separated list of WIDTHxHEIGHT (default: 256x256,1280x720,1920x1080)\n"
+              << "  --threads LIST   comma separated list of thread counts (default: 1 and all cores)\n"
+              << "  --min-time MS    minimum duration of each measurement (default: 100)\n"
+              << "  --plugin         register the YCbCr optimization plugin first\n"
+              << "  --lcms-plugins LIST\n"
+              << "                   comma separated list of fast_float, threaded: the\n"
+              << "                   LittleCMS plugins to register, if built with them; with\n"
+              << "                   --flags, every profile is measured both without and\n"
+              << "                   with them\n"
+              << "  --arena          open the profiles and create each transform in an arena\n"
+              << "                   context, and report their allocations and peak bytes\n"
+              << "                   (the creation time then includes reading the tags)\n"
+              << "  --flags          instead, for every combination of cmsFLAGS_NOCACHE with\n"
+              << "                   nothing, HIGHRESPRECALC, LOWRESPRECALC or NOOPTIMIZE,\n"
+              << "                   measure the creation latency, the single thread\n"
+              << "                   throughput at the last of --sizes, and the largest and\n"
+              << "                   mean error against an unoptimized floating point\n"
+              << "                   transform, in code values of the format (16-bit ones for\n"
+              << "                   floating point)\n"
+              << "  --destinations LIST\n"
+              << "                   comma separated list of srgb, p3, bt709: the RGB side of\n"
+              << "                   the transforms with --flags (default: srgb)\n"
+              << "  --recommend FILE with --flags, write the recommended flags of each\n"
+              << "                   profile, destination, direction and format to FILE, for\n"
+              << "                   ycbcr::readFlagsTable (see ycbcr_flags.h); those of the\n"
+              << "                   runs with --lcms-plugins, if any\n"
+              << "  --converter      instead, without any PROFILE, measure the throughput of\n"
+              << "                   ycbcr::Converter with each instruction set at the last of\n"
+              << "                   --sizes, and fail unless they all give the same samples as\n"
+              << "                   the scalar fallback, and those are within one code value\n"
+              << "                   (16-bit for floating point) of the analytic conversion\n"
+              << "  --output FILE    write the results to FILE instead of stdout\n";
+}
+
+std::vector<std::string> split(const std::string &list)
+{
+    std::vector<std::string> items;
+    std::stringstream stream(list);
+    std::string item;
+    while (std::getline(stream, item, ',')) {
+        if (!item.empty()) {
+            items.push_back(item);
+        }
+    }
+    return items;
+}
+
+bool parseSizes(const std::string &list, std::vector<Size> &sizes)
+{
+    sizes.clear();
+    for (const auto &item : split(list)) {
+        const auto x = item.find('x');
+        const auto width = std::atoi(item.substr(0, x).c_str());
+        const auto height = x == std::string::npos ? 0 : std::atoi(item.substr(x + 1).c_str());
+        if (width <= 0 || height <= 0) {
+            std::cerr << "Invalid size: " << item << std::endl;
+            return false;
+        }
+        sizes.push_back({static_cast<cmsUInt32Number>(width), static_cast<cmsUInt32Number>(height)});
+    }
+    return !sizes.empty();
+}
+
+bool parseDestinations(const std::string &list, std::vector<ycbcr::Display> &destinations)
+{
+    destinations.clear();
+    for (const auto &item : split(list)) {
+        const auto candidates = {ycbcr::Display::SRGB, ycbcr::Display::DisplayP3, ycbcr::Display::BT709};
+        const auto it = std::find_if(candidates.begin(), candidates.end(), [&](ycbcr::Display display) {
+            return item == ycbcr::displayFileName(display);
+        });
+        if (it == candidates.end()) {
+            std::cerr << "Unknown destination: " << item << std::endl;
+            return false;
+        }
+        destinations.push_back(*it);
+    }
+    return !destinations.empty();
+}
+
+bool parseThreads(const std::string &list, std::vector<unsigned int> &threads)
+{
+    threads.clear();
+    for (const auto &item : split(list)) {
+        const auto n = std::atoi(item.c_str());
+        if (n <= 0) {
+            std::cerr << "Invalid thread count: " << item << std::endl;
+            return false;
+        }
+        threads.push_back(static_cast<unsigned int>(n));
+    }
+    return !threads.empty();
+}
+
+// A deterministic frame, covering the whole range of the format.
+std::vector<cmsUInt8Number> makeFrame(const Format &format, const Size &size)
+{
+    const size_t pixels = static_cast<size_t>(size.width) * size.height;
+    std::vector<cmsUInt8Number> frame(pixels * format.bytesPerPixel);
+    cmsUInt32Number seed = 0x12345678;
+    const auto next = [&seed]() {
+        seed = seed * 1664525U + 1013904223U;
+        return seed;
+    };
+    if (T_FLOAT(format.yCbCr)) {
+        auto *values = reinterpret_cast<cmsFloat32Number *>(frame.data());
+        for (size_t i = 0; i < pixels * 3; i++) {
+            values[i] = static_cast<cmsFloat32Number>(next() >> 8) / static_cast<cmsFloat32Number>(1 << 24);
+        }
+    } else {
+        for (auto &v : frame) {
+            v = static_cast<cmsUInt8Number>(next() >> 24);
+        }
+    }
+    return frame;
+}
+
+// Transforms the frame split in row bands, one per thread, until the
+// minimum duration is reached. Returns the number of frames per second.
+cmsFloat64Number framesPerSecond(cmsHTRANSFORM transform,
+                                 const Format &format,
+                                 const Size &size,
+                                 unsigned int threads,
+                                 const std::vector<cmsUInt8Number> &input,
+                                 std::vector<cmsUInt8Number> &output,
+                                 std::chrono::milliseconds minimumDuration)
+{
+    threads = std::min(threads, size.height);
+    const auto bandHeight = (size.height + threads - 1) / threads;
+    const auto rowBytes = static_cast<size_t>(size.width) * format.bytesPerPixel;
+    const auto transformBand = [&](cmsUInt32Number firstRow) {
+        const auto rows = std::min(bandHeight, size.height - firstRow);
+        cmsDoTransform(transform, input.data() + firstRow * rowBytes, output.data() + firstRow * rowBytes, size.width * rows);
+    };
+
+    size_t frames = 0;
+    const auto start = clock::now();
+    auto elapsed = clock::duration::zero();
+    do {
+        if (threads == 1) {
+            transformBand(0);
+        } else {
+            std::vector<std::thread> workers;
+            for (cmsUInt32Number row = bandHeight; row < size.height; row += bandHeight) {
+                workers.emplace_back(transformBand, row);
+            }
+            transformBand(0);
+            for (auto &t : workers) {
+                t.join();
+            }
+        }
+        frames++;
+        elapsed = clock::now() - start;
+    } while (elapsed < minimumDuration);
+
+    return static_cast<cmsFloat64Number>(frames) / std::chrono::duration<cmsFloat64Number>(elapsed).count();
+}
+
+bool benchmarkProfile(cmsContext ctx, ycbcr::Arena *arena, const std::string &path, const Options &options, std::ostream &out)
+{
+    auto yCbCr = cmsOpenProfileFromFileTHR(ctx, path.c_str(), "r");
+    if (!yCbCr) {
+        std::cerr << "Cannot open profile " << path << std::endl;
+        return false;
+    }
+    auto sRGB = cmsCreate_sRGBProfileTHR(ctx);
+
+    const auto name = path.substr(path.find_last_of("/\\") + 1);
+    bool ok = true;
+    for (const auto &format : formats) {
+        for (const auto toRGB : {true, false}) {
+            const auto inputFormat = toRGB ? format.yCbCr : format.rgb;
+            const auto outputFormat = toRGB ? format.rgb : format.yCbCr;
+
+            cmsHTRANSFORM transform = nullptr;
+            auto creation = clock::duration::zero();
+            ycbcr::ArenaStats arenaStats{};
+            for (size_t i = 0; i < options.creations; i++) {
+                if (transform) {
+                    cmsDeleteTransform(transform);
+                    transform = nullptr;
+                }
+                auto transformCtx = ctx;
+                auto transformYCbCr = yCbCr;
+                auto transformSRGB = sRGB;
+                // LittleCMS copies the tags into the profiles' context, so
+                // they are reopened in the arena along with the transform.
+                // Whatever the last round left there is dropped unfreed.
+                if (arena) {
+                    if (!arena->reset()) {
+                        break;
+                    }
+                    transformCtx = arena->context();
+                    transformYCbCr = cmsOpenProfileFromFileTHR(transformCtx, path.c_str(), "r");
+                    transformSRGB = cmsCreate_sRGBProfileTHR(transformCtx);
+                    if (!transformYCbCr || !transformSRGB) {
+                        break;
+                    }
+                }
+                const auto input = toRGB ? transformYCbCr : transformSRGB;
+                const auto output = toRGB ? transformSRGB : transformYCbCr;
+                const auto start = clock::now();
+                transform = cmsCreateTransformTHR(transformCtx, input, inputFormat, output, outputFormat, INTENT_PERCEPTUAL, 0);
+                creation += clock::now() - start;
+                if (!transform) {
+                    break;
+                }
+                if (arena) {
+                    arenaStats = arena->stats();
+                }
+            }
+            if (!transform) {
+                std::cerr << "Cannot create the " << format.name << " transform for " << name << std::endl;
+                ok = false;
+                continue;
+            }
+            const auto creationMs = std::chrono::duration<cmsFloat64Number, std::milli>(creation).count() / static_cast<cmsFloat64Number>(options.creations);
+
+            for (const auto &size : options.sizes) {
+                const auto frame = makeFrame(format, size);
+                std::vector<cmsUInt8Number> result(frame.size());
+                for (const auto threads : options.threads) {
+                    const auto fps = framesPerSecond(transform, format, size, threads, frame, result, options.minimumDuration);
+                    out << name << '\t' << (toRGB ? "ycbcr_to_srgb" : "srgb_to_ycbcr") << '\t' << format.name << '\t' << size.width << '\t'
+                        << size.height << '\t' << threads << '\t' << std::fixed << std::setprecision(3) << creationMs << '\t' << std::setprecision(2)
+                        << fps * size.width * size.height / 1e6;
+                    if (arena) {
+                        out << '\t' << arenaStats.allocations << '\t' << arenaStats.peakBytes;
+                    }
+                    out << '\n' << std::flush;
+                }
+            }
+
+            cmsDeleteTransform(transform);
+        }
+    }
+
+    cmsCloseProfile(sRGB);
+    cmsCloseProfile(yCbCr);
+    return ok;
+}
+
+// The samples of a frame, normalized to [0, 1] like lcms' floating point
+// formats.
+std::vector<cmsFloat32Number> normalize(const Format &format, const std::vector<cmsUInt8Number> &frame)
+{
+    std::vector<cmsFloat32Number> values(frame.size() / (format.bytesPerPixel / 3));
+    for (size_t i = 0; i < values.size(); i++) {
+        if (T_FLOAT(format.yCbCr)) {
+            values[i] = reinterpret_cast<const cmsFloat32Number *>(frame.data())[i];
+        } else if (T_BYTES(format.yCbCr) == 1) {
+            values[i] = static_cast<cmsFloat32Number>(frame[i]) / 255.0f;
+        } else {
+            values[i] = static_cast<cmsFloat32Number>(reinterpret_cast<const cmsUInt16Number *>(frame.data())[i]) / 65535.0f;
+        }
+    }
+    return values;
+}
+
+// Code values of the format, or 16-bit ones for floating point.
+cmsFloat64Number codeScale(const Format &format)
+{
+    return T_BYTES(format.yCbCr) == 1 ? 255.0 : 65535.0;
+}
+
+struct FlagsMeasurement {
+    cmsUInt32Number flags;
+    cmsFloat64Number creationMs;
+    cmsFloat64Number framesPerSecond;
+    cmsFloat64Number errorMax;
+    cmsFloat64Number errorMean;
+};
+
+// The fastest flags, counting the creation and one frame, among those no
+// less accurate than the default ones, give or take half a code value.
+cmsUInt32Number recommend(const std::vector<FlagsMeasurement> &measurements)
+{
+    const auto &defaults = measurements.front();
+    const FlagsMeasurement *best = nullptr;
+    cmsFloat64Number bestCost = 0;
+    for (const auto &m : measurements) {
+        if (m.errorMax > defaults.errorMax + 0.5) {
+            continue;
+        }
+        const auto cost = m.creationMs + 1000.0 / m.framesPerSecond;
+        if (!best || cost < bestCost) {
+            best = &m;
+            bestCost = cost;
+        }
+    }
+    return best ? best->flags : defaults.flags;
+}
+
+// Where benchmarkFlags creates its transforms.
+struct FlagsContexts {
+    // Without any plugin, for the reference transforms.
+    cmsContext reference = nullptr;
+    // Every context is measured in turn, and reported with the name of the
+    // LittleCMS plugins registered in it. The recommendations come from the
+    // last one.
+    std::vector<std::pair<cmsContext, std::string>> runs;
+};
+
+bool benchmarkFlags(const FlagsContexts &contexts, const std::string &path, const Options &options, std::ostream &out, ycbcr::FlagsTable &table)
+{
+    auto yCbCr = cmsOpenProfileFromFileTHR(contexts.reference, path.c_str(), "r");
+    if (!yCbCr) {
+        std::cerr << "Cannot open profile " << path << std::endl;
+        return false;
+    }
+
+    const auto name = path.substr(path.find_last_of("/\\") + 1);
+    // Small enough for the unoptimized reference to be quick.
+    const Size sample{256, 256};
+    const auto &size = options.sizes.back();
+    bool ok = true;
+    for (const auto destination : options.destinations) {
+        auto rgb = ycbcr::createDisplayProfile(contexts.reference, destination);
+        if (!rgb) {
+            std::cerr << "Cannot create the " << ycbcr::displayFileName(destination) << " profile" << std::endl;
+            ok = false;
+            continue;
+        }
+        for (const auto &format : formats) {
+            for (const auto toRGB : {true, false}) {
+                const auto input = toRGB ? yCbCr : rgb;
+                const auto output = toRGB ? rgb : yCbCr;
+                const auto inputFormat = toRGB ? format.yCbCr : format.rgb;
+                const auto outputFormat = toRGB ? format.rgb : format.yCbCr;
+                const auto inputFloat = toRGB ? TYPE_YCbCr_FLT : TYPE_RGB_FLT;
+                const auto outputFloat = toRGB ? TYPE_RGB_FLT : TYPE_YCbCr_FLT;
+                const std::string direction = toRGB ? "ycbcr_to_rgb" : "rgb_to_ycbcr";
+
+                const auto samples = makeFrame(format, sample);
+                const auto pixels = static_cast<cmsUInt32Number>(sample.width * sample.height);
+                auto reference = normalize(format, samples);
+                auto referenceTransform = cmsCreateTransformTHR(contexts.reference,
+                                                                input,
+                                                                inputFloat,
+                                                                output,
+                                                                outputFloat,
+                                                                INTENT_PERCEPTUAL,
+                                                                cmsFLAGS_NOOPTIMIZE | cmsFLAGS_NOCACHE);
+                if (!referenceTransform) {
+                    std::cerr << "Cannot create the reference transform for " << name << std::endl;
+                    ok = false;
+                    continue;
+                }
+                cmsDoTransform(referenceTransform, reference.data(), reference.data(), pixels);
+                cmsDeleteTransform(referenceTransform);
+                if (!T_FLOAT(format.yCbCr)) {
+                    for (auto &v : reference) {
+                        v = std::min(std::max(v, 0.0f), 1.0f);
+                    }
+                }
+
+                for (const auto &run : contexts.runs) {
+                    std::vector<FlagsMeasurement> measurements;
+                    for (const auto flags : ycbcr::flagCombinations()) {
+                        cmsHTRANSFORM transform = nullptr;
+                        auto creation = clock::duration::zero();
+                        for (size_t i = 0; i < options.creations; i++) {
+                            if (transform) {
+                                cmsDeleteTransform(transform);
+                            }
+                            const auto start = clock::now();
+                            transform = cmsCreateTransformTHR(run.first, input, inputFormat, output, outputFormat, INTENT_PERCEPTUAL, flags);
+                            creation += clock::now() - start;
+                            if (!transform) {
+                                break;
+                            }
+                        }
+                        if (!transform) {
+                            std::cerr << "Cannot create the " << format.name << " transform for " << name << " with " << ycbcr::flagsName(flags) << std::endl;
+                            ok = false;
+                            continue;
+                        }
+
+                        std::vector<cmsUInt8Number> result(samples.size());
+                        cmsDoTransform(transform, samples.data(), result.data(), pixels);
+                        const auto values = normalize(format, result);
+                        cmsFloat64Number errorMax = 0;
+                        cmsFloat64Number errorSum = 0;
+                        for (size_t i = 0; i < values.size(); i++) {
+                            const auto difference = static_cast<cmsFloat64Number>(values[i]) - reference[i];
+                            const auto error = std::max(difference, -difference) * codeScale(format);
+                            errorMax = std::max(errorMax, error);
+                            errorSum += error;
+                        }
+
+                        const auto frame = makeFrame(format, size);
+                        std::vector<cmsUInt8Number> frameResult(frame.size());
+                        const FlagsMeasurement m{flags,
+                                                 std::chrono::duration<cmsFloat64Number, std::milli>(creation).count() / static_cast<cmsFloat64Number>(options.creations),
+                                                 framesPerSecond(transform, format, size, 1, frame, frameResult, options.minimumDuration),
+                                                 errorMax,
+                                                 errorSum / static_cast<cmsFloat64Number>(values.size())};
+                        cmsDeleteTransform(transform);
+                        measurements.push_back(m);
+
+                        out << name << '\t' << ycbcr::displayFileName(destination) << '\t' << direction << '\t' << format.name << '\t' << ycbcr::flagsName(flags)
+                            << '\t' << std::fixed << std::setprecision(3) << m.creationMs << '\t' << std::setprecision(2)
+                            << m.framesPerSecond * size.width * size.height / 1e6 << '\t' << std::setprecision(4) << m.errorMax << '\t' << m.errorMean
+                            << '\t' << run.second << '\n'
+                            << std::flush;
+                    }
+                    if (!measurements.empty() && &run == &contexts.runs.back()) {
+                        table.push_back({name, ycbcr::displayFileName(destination), direction, format.name, recommend(measurements)});
+                    }
+                }
+            }
+        }
+        cmsCloseProfile(rgb);
+    }
+
+    cmsCloseProfile(yCbCr);
+    return ok;
+}
+
+// The conversions ycbcr::Converter is checked with: every matrix, every
+// range, and the curves it applies to linear light.
+struct ConverterCase {
+    const char *name;
+    ycbcr::ConverterParams params;
+};
+
+const std::vector<ConverterCase> converterCases = {
+    {"bt601", {ycbcr::Standard::BT601, ycbcr::Curve::OETF, false, ycbcr::Range::Full}},
+    {"bt709", {ycbcr::Standard::BT709, ycbcr::Curve::OETF, false, ycbcr::Range::Full}},
+    {"bt2020", {ycbcr::Standard::BT2020, ycbcr::Curve::OETF, false, ycbcr::Range::Full}},
+    {"bt709_limited8", {ycbcr::Standard::BT709, ycbcr::Curve::OETF, false, ycbcr::Range::Limited8}},
+    {"bt709_limited10", {ycbcr::Standard::BT709, ycbcr::Curve::OETF, false, ycbcr::Range::Limited10}},
+    {"bt709_linear", {ycbcr::Standard::BT709, ycbcr::Curve::OETF, true, ycbcr::Range::Full}},
+    {"bt709_bt1886_linear", {ycbcr::Standard::BT709, ycbcr::Curve::BT1886, true, ycbcr::Range::Full}},
+};
+
+struct ConverterFormat {
+    const char *name;
+    ycbcr::SampleType type;
+    size_t bytesPerSample;
+    // Largest code value, 1 for floating point.
+    cmsFloat64Number maximum;
+};
+
+const std::vector<ConverterFormat> converterFormats = {
+    {"8", ycbcr::SampleType::UInt8, sizeof(cmsUInt8Number), 255.0},
+    {"10", ycbcr::SampleType::UInt10, sizeof(cmsUInt16Number), 1023.0},
+    {"16", ycbcr::SampleType::UInt16, sizeof(cmsUInt16Number), 65535.0},
+    {"FLT", ycbcr::SampleType::Float, sizeof(cmsFloat32Number), 1.0},
+};
+
+// Largest error against the analytic conversion, in code values of the
+// format (16-bit ones for floating point), before the check fails. The
+// integer formats are allowed their rounding plus the single precision
+// math, the floating point one the latter alone.
+constexpr cmsFloat64Number converterErrorLimit = 1.0;
+
+// A deterministic frame of pixels, covering the whole range of the format.
+std::vector<cmsUInt8Number> makeConverterFrame(const ConverterFormat &format, size_t pixels)
+{
+    std::vector<cmsUInt8Number> frame(pixels * 3 * format.bytesPerSample);
+    cmsUInt32Number seed = 0x12345678;
+    const auto next = [&seed]() {
+        seed = seed * 1664525U + 1013904223U;
+        return seed;
+    };
+    for (size_t i = 0; i < pixels * 3; i++) {
+        switch (format.type) {
+        case ycbcr::SampleType::UInt8:
+            frame[i] = static_cast<cmsUInt8Number>(next() >> 24);
+            break;
+        case ycbcr::SampleType::UInt10:
+            reinterpret_cast<cmsUInt16Number *>(frame.data())[i] = static_cast<cmsUInt16Number>(next() >> 22);
+            break;
+        case ycbcr::SampleType::UInt16:
+            reinterpret_cast<cmsUInt16Number *>(frame.data())[i] = static_cast<cmsUInt16Number>(next() >> 16);
+            break;
+        case ycbcr::SampleType::Float:
+            reinterpret_cast<cmsFloat32Number *>(frame.data())[i] = static_cast<cmsFloat32Number>(next() >> 8) / static_cast<cmsFloat32Number>(1 << 24);
+            break;
+        }
+    }
+    return frame;
+}
+
+cmsFloat64Number sample(const ConverterFormat &format, const std::vector<cmsUInt8Number> &frame, size_t i)
+{
+    switch (format.type) {
+    case ycbcr::SampleType::UInt8:
+        return frame[i];
+    case ycbcr::SampleType::Float:
+        return reinterpret_cast<const cmsFloat32Number *>(frame.data())[i];
+    default:
+        return reinterpret_cast<const cmsUInt16Number *>(frame.data())[i];
+    }
+}
+
+// The analytic conversion of one pixel, normalized.
+ycbcr::Triplet referencePixel(const ycbcr::ConverterParams &params, bool toRGB, ycbcr::Triplet in)
+{
+    ycbcr::Params profile;
+    profile.standard = params.standard;
+    profile.curve = params.curve;
+    profile.range = params.range;
+    if (toRGB) {
+        auto rgb = ycbcr::yCbCrToRGB(profile, in);
+        if (params.linear) {
+            for (auto &v : rgb) {
+                v = ycbcr::eotf(params.curve, v);
+            }
+        }
+        return rgb;
+    }
+    if (params.linear) {
+        for (auto &v : in) {
+            v = ycbcr::oetf(params.curve, v);
+        }
+    }
+    return ycbcr::rgbToYCbCr(profile, in);
+}
+
+// Runs the converter over a frame of the last of --sizes with every
+// instruction set the build and the CPU support, and checks that each one
+// gives the same samples as the scalar fallback, and that those are within
+// converterErrorLimit of the analytic conversion.
+bool benchmarkConverter(const Options &options, std::ostream &out)
+{
+    const auto &size = options.sizes.back();
+    const size_t pixels = static_cast<size_t>(size.width) * size.height;
+    bool ok = true;
+    for (const auto &c : converterCases) {
+        for (const bool toRGB : {true, false}) {
+            const char *direction = toRGB ? "ycbcr_to_rgb" : "rgb_to_ycbcr";
+            for (const auto &format : converterFormats) {
+                const auto frame = makeConverterFrame(format, pixels);
+                const ycbcr::Converter scalar(c.params, ycbcr::Isa::Scalar);
+                std::vector<cmsUInt8Number> expected(frame.size());
+                if (toRGB) {
+                    scalar.toRGB(frame.data(), expected.data(), pixels, format.type);
+                } else {
+                    scalar.toYCbCr(frame.data(), expected.data(), pixels, format.type);
+                }
+
+                // The scalar fallback against the analytic conversion, with
+                // the integer formats clamped like the converter does.
+                const auto codeValues = format.type == ycbcr::SampleType::Float ? 65535.0 : 1.0;
+                cmsFloat64Number errorMax = 0;
+                cmsFloat64Number errorSum = 0;
+                for (size_t i = 0; i < pixels * 3; i += 3) {
+                    ycbcr::Triplet in{};
+                    for (size_t j = 0; j < 3; j++) {
+                        in[j] = sample(format, frame, i + j) / format.maximum;
+                    }
+                    const auto reference = referencePixel(c.params, toRGB, in);
+                    for (size_t j = 0; j < 3; j++) {
+                        auto value = reference[j] * format.maximum;
+                        if (format.type != ycbcr::SampleType::Float) {
+                            value = std::min(std::max(value, 0.0), format.maximum);
+                        }
+                        const auto difference = sample(format, expected, i + j) - value;
+                        const auto error = std::max(difference, -difference) * codeValues;
+                        errorMax = std::max(errorMax, error);
+                        errorSum += error;
+                    }
+                }
+                if (errorMax > converterErrorLimit) {
+                    std::cerr << "The " << format.name << " " << direction << " conversion of " << c.name << " is off by up to " << errorMax
+                              << " code values" << std::endl;
+                    ok = false;
+                }
+
+                for (const auto isa : {ycbcr::Isa::Scalar, ycbcr::Isa::SSE2, ycbcr::Isa::AVX2, ycbcr::Isa::AVX512}) {
+                    if (!ycbcr::isaSupported(isa) && isa != ycbcr::Isa::Scalar) {
+                        continue;
+                    }
+                    const ycbcr::Converter converter(c.params, isa);
+                    std::vector<cmsUInt8Number> result(frame.size());
+                    size_t frames = 0;
+                    const auto start = clock::now();
+                    auto elapsed = clock::duration::zero();
+                    do {
+                        if (toRGB) {
+                            converter.toRGB(frame.data(), result.data(), pixels, format.type);
+                        } else {
+                            converter.toYCbCr(frame.data(), result.data(), pixels, format.type);
+                        }
+                        frames++;
+                        elapsed = clock::now() - start;
+                    } while (elapsed < options.minimumDuration);
+                    const auto framesPerSecond = static_cast<cmsFloat64Number>(frames) / std::chrono::duration<cmsFloat64Number>(elapsed).count();
+
+                    size_t mismatches = 0;
+                    for (size_t i = 0; i < pixels * 3; i++) {
+                        if (sample(format, result, i) != sample(format, expected, i)) {
+                            mismatches++;
+                        }
+                    }
+                    if (mismatches) {
+                        std::cerr << ycbcr::isaName(isa) << " gives " << mismatches << " samples that differ from the scalar fallback in the " << format.name
+                                  << " " << direction << " conversion of " << c.name << std::endl;
+                        ok = false;
+                    }
+
+                    out << c.name << '\t' << direction << '\t' << format.name << '\t' << ycbcr::isaName(isa) << '\t' << std::fixed << std::setprecision(2)
+                        << framesPerSecond * static_cast<cmsFloat64Number>(pixels) / 1e6 << '\t' << mismatches << '\t' << std::setprecision(4) << errorMax
+                        << '\t' << errorSum / static_cast<cmsFloat64Number>(pixels * 3) << '\n'
+                        << std::flush;
+                }
+            }
+        }
+    }
+    return ok;
+}
+} // namespace
+
+int main(int argc, char **argv)
+{
+    Options options;
+
+    for (int i = 1; i < argc; i++) {
+        const std::string arg{argv[i]};
+        if (arg == "--help" || arg == "-h") {
+            usage(argv[0]);
+            return 0;
+        }
+        if (arg.rfind("--", 0) != 0) {
+            options.profiles.push_back(arg);
+            continue;
+        }
+        if (arg == "--plugin") {
+            options.plugin = true;
+            continue;
+        }
+        if (arg == "--arena") {
+            options.arena = true;
+            continue;
+        }
+        if (arg == "--flags") {
+            options.flags = true;
+            continue;
+        }
+        if (arg == "--converter") {
+            options.converter = true;
+            continue;
+        }
+        if (i + 1 >= argc) {
+            usage(argv[0]);
+            return 1;
+        }
+        const std::string value{argv[++i]};
+        bool ok = true;
+        if (arg == "--sizes") {
+            ok = parseSizes(value, options.sizes);
+        } else if (arg == "--threads") {
+            ok = parseThreads(value, options.threads);
+        } else if (arg == "--min-time") {
+            options.minimumDuration = std::chrono::milliseconds{std::max(0, std::atoi(value.c_str()))};
+        } else if (arg == "--destinations") {
+            ok = parseDestinations(value, options.destinations);
+        } else if (arg == "--lcms-plugins") {
+            ok = ycbcr::parseLcmsPlugins(value, options.lcmsPlugins);
+        } else if (arg == "--recommend") {
+            options.recommend = value;
+        } else if (arg == "--output") {
+            options.output = value;
+        } else {
+            usage(argv[0]);
+            return 1;
+        }
+        if (!ok) {
+            return 1;
+        }
+    }
+
+    if (options.profiles.empty() != options.converter) {
+        usage(argv[0]);
+        return 1;
+    }
+    if (options.arena && !options.lcmsPlugins.empty()) {
+        std::cerr << "--arena and --lcms-plugins cannot be combined" << std::endl;
+        return 1;
+    }
+
+    std::ofstream file;
+    if (!options.output.empty()) {
+        file.open(options.output);
+        if (!file) {
+            std::cerr << "Cannot write to " << options.output << std::endl;
+            return 1;
+        }
+    }
+    auto &out = options.output.empty() ? std::cout : file;
+
+    if (options.converter) {
+        out << "conversion\tdirection\tformat\tisa\tmpix_s\tmismatches\terror_max\terror_mean\n";
+        return benchmarkConverter(options, out) ? 0 : 1;
+    }
+
+    auto ctx = cmsCreateContext(nullptr, nullptr);
+    cmsSetLogErrorHandlerTHR(ctx, log);
+    if (options.plugin && !ycbcr::registerOptimization(ctx)) {
+        std::cerr << "Cannot register the optimization plugin" << std::endl;
+        cmsDeleteContext(ctx);
+        return 1;
+    }
+
+    if (options.flags) {
+        FlagsContexts contexts;
+        contexts.reference = cmsCreateContext(nullptr, nullptr);
+        cmsSetLogErrorHandlerTHR(contexts.reference, log);
+        contexts.runs.emplace_back(ctx, "none");
+        if (!options.lcmsPlugins.empty()) {
+            auto pluginCtx = cmsDupContext(ctx, nullptr);
+            if (!pluginCtx || !ycbcr::registerLcmsPlugins(pluginCtx, options.lcmsPlugins)) {
+                if (pluginCtx) {
+                    cmsDeleteContext(pluginCtx);
+                }
+                cmsDeleteContext(contexts.reference);
+                cmsDeleteContext(ctx);
+                return 1;
+            }
+            contexts.runs.emplace_back(pluginCtx, ycbcr::lcmsPluginsName(options.lcmsPlugins));
+        }
+
+        out << "profile\tdestination\tdirection\tformat\tflags\tcreate_ms\tmpix_s\terror_max\terror_mean\tlcms_plugins\n";
+        ycbcr::FlagsTable table;
+        int result = 0;
+        for (const auto &profile : options.profiles) {
+            if (!benchmarkFlags(contexts, profile, options, out, table)) {
+                result = 1;
+            }
+        }
+        for (const auto &run : contexts.runs) {
+            cmsDeleteContext(run.first);
+        }
+        cmsDeleteContext(contexts.reference);
+        if (!options.recommend.empty()) {
+            std::ofstream recommended(options.recommend);
+            writeFlagsTable(recommended, table);
+            if (!recommended) {
+                std::cerr << "Cannot write to " << options.recommend << std::endl;
+                result = 1;
+            }
+        }
+        return result;
+    }
+
+    if (!ycbcr::registerLcmsPlugins(ctx, options.lcmsPlugins)) {
+        cmsDeleteContext(ctx);
+        return 1;
+    }
+
+    std::unique_ptr<ycbcr::Arena> arena;
+    if (options.arena) {
+        std::vector<cmsPluginBase *> plugins;
+        if (options.plugin) {
+            plugins.push_back(ycbcr::optimizationPlugin());
+        }
+        arena = std::make_unique<ycbcr::Arena>(log, plugins);
+        if (!arena->context()) {
+            std::cerr << "Cannot create the arena context" << std::endl;
+            cmsDeleteContext(ctx);
+            return 1;
+        }
+    }
+
+    // Tab separated values, one line per measurement.
+    out << "profile\tdirection\tformat\twidth\theight\tthreads\tcreate_ms\tmpix_s";
+    if (arena) {
+        out << "\tcreate_allocs\tcreate_peak_bytes";
+    }
+    out << '\n';
+    int result = 0;
+    for (const auto &profile : options.profiles) {
+        if (!benchmarkProfile(ctx, arena.get(), profile, options, out)) {
+            result = 1;
+        }
+    }
+
+    cmsDeleteContext(ctx);
+    return result;
+}
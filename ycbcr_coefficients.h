@@ -0,0 +1,136 @@
+// SPDX-FileCopyrightText: 2022 Amyspark <amy@amyspark.me>
+// SPDX-License-Identifier: BSD-3-Clause
+
+#pragma once
+
+#include <lcms2.h>
+
+#include <array>
+
+namespace ycbcr
+{
+// Source: Tooms (2015), table 11.1, p.192
+constexpr cmsCIExyY d65 = {0.3127, 0.3290, 1.0};
+
+// Elle Stone's prequantized sRGB primaries
+// Match: Tooms (2015), table 19.1
+constexpr cmsCIExyYTRIPLE sRGBPrimariesPreQuantized = {{0.639998686, 0.330010138, 1.0}, {0.300003784, 0.600003357, 1.0}, {0.150002046, 0.059997204, 1.0}};
+
+// Display P3 primaries, under D65.
+// Source: SMPTE EG 432-1:2010, table 1
+constexpr cmsCIExyYTRIPLE displayP3Primaries = {{0.680, 0.320, 1.0}, {0.265, 0.690, 1.0}, {0.150, 0.060, 1.0}};
+
+// sRGB EOTF, as a type 4 parametric curve (used by Display P3 as well).
+// Source: IEC 61966-2-1:1999, ss. 5.2
+constexpr std::array<cmsFloat64Number, 5> sRGBParameters = {2.4, 1.0 / 1.055, 0.055 / 1.055, 1.0 / 12.92, 0.04045};
+
+// Inverse OETF curve
+//
+// Source: basic algebra on ITU-R BT.709-6, ss. 1.2
+// (identical to ITU-R BT.601-7, ss. 2.6.4)
+constexpr std::array<cmsFloat64Number, 5> rec709ParametersInv = {1.0 / 0.45, 1.0 / 1.099, 0.099 / 1.099, 1.0 / 4.5, 0.081};
+
+// OETF curve, as a type 5 parametric curve: (a * L)^0.45 - 0.099, with a =
+// 1.099^(1 / 0.45) so that it is 1.099 * L^0.45 - 0.099.
+//
+// Source: ITU-R BT.709-6, ss. 1.2
+// (identical to ITU-R BT.601-7, ss. 2.6.4)
+constexpr std::array<cmsFloat64Number, 7> rec709Parameters = {0.45, 1.2334057909982274, 0, 4.5, 0.018, -0.099, 0};
+
+// BT.1886 EOTF exponent.
+constexpr cmsFloat64Number bt1886Gamma = 2.4;
+
+// PQ EOTF constants.
+// Source: ITU-R BT.2100-2, table 4
+constexpr cmsFloat64Number pqM1 = 2610.0 / 16384.0;
+constexpr cmsFloat64Number pqM2 = 2523.0 / 4096.0 * 128.0;
+constexpr cmsFloat64Number pqC1 = 3424.0 / 4096.0;
+constexpr cmsFloat64Number pqC2 = 2413.0 / 4096.0 * 32.0;
+constexpr cmsFloat64Number pqC3 = 2392.0 / 4096.0 * 32.0;
+// Luminance of the PQ signal 1, in cd/m^2.
+constexpr cmsFloat64Number pqPeakLuminance = 10000;
+
+// HLG OETF constants.
+// Source: ITU-R BT.2100-2, table 5
+constexpr cmsFloat64Number hlgA = 0.17883277;
+constexpr cmsFloat64Number hlgB = 0.28466892;
+constexpr cmsFloat64Number hlgC = 0.55991073;
+
+// HDR reference (diffuse) white: its luminance, in cd/m^2, and its HLG
+// signal level.
+// Source: ITU-R BT.2408-7, ss. 2.2
+constexpr cmsFloat64Number hdrReferenceWhite = 203;
+constexpr cmsFloat64Number hlgReferenceSignal = 0.75;
+
+// Chrominance channels are [-0.5, 0.5]. Adjust.
+constexpr std::array<double, 3 * 3> identity = {{1, 0, 0, 0, 1, 0, 0, 0, 1}};
+constexpr std::array<double, 3> offset_ycbcr_to_rgb = {0, -0.5, -0.5};
+constexpr std::array<double, 3> offset_i = {0, 0.5, 0.5};
+
+// 8-bit limited range quantization levels: black and white for Y', and the
+// achromatic level and excursion for Cb and Cr. At n bits, every level is
+// multiplied by 2^(n - 8).
+// Source: ITU-R BT.601-7, ss. 2.5.3; ITU-R BT.709-6, ss. 4.6
+constexpr double limitedBlack = 16;
+constexpr double limitedWhite = 235;
+constexpr double limitedAchromatic = 128;
+constexpr double limitedChromaExcursion = 224;
+
+// Linear RGB -> XYZ.
+// Source: <https://photosauce.net/blog/post/making-a-minimal-srgb-icc-profile-part-3-choose-your-colors-carefully>
+// NOTE: these must be computed under D65!!!
+constexpr std::array<double, 3 * 3> rgb_to_xyz = {{0.4124, 0.3576, 0.1805, 0.2126, 0.7152, 0.0722, 0.0193, 0.1192, 0.9505}};
+
+// XYZ -> Linear RGB.
+// Source: <https://photosauce.net/blog/post/making-a-minimal-srgb-icc-profile-part-3-choose-your-colors-carefully>
+constexpr std::array<double, 3 * 3> xyz_to_rgb = {{3.2406, -1.5372, -0.4986, -0.9689, 1.8758, 0.0415, 0.0557, -0.2040, 1.0570}};
+
+// Same as above, for the BT.2020 primaries.
+// Source: ITU-R BT.2020-2, table 3, under D65 (computed)
+constexpr std::array<double, 3 * 3> bt2020_rgb_to_xyz = {
+    {0.6369580483, 0.1446169036, 0.1688809752, 0.2627002120, 0.6779980715, 0.0593017165, 0, 0.0280726930, 1.0609850577}};
+constexpr std::array<double, 3 * 3> bt2020_xyz_to_rgb = {
+    {1.7166511880, -0.3556707838, -0.2533662814, -0.6666843518, 1.6164812366, 0.0157685458, 0.0176398574, -0.0427706133, 0.9421031212}};
+
+struct Coefficients {
+    // Human readable name, used in the profile description.
+    const char *name;
+    // Prefix of the generated file names.
+    const char *fileName;
+    // YCbCr -> normalized R'G'B. Source: Wolfram Alpha, inverted matrix.
+    std::array<double, 3 * 3> ycbcr_to_rgb;
+    // Normalized R'G'B -> YCbCr.
+    std::array<double, 3 * 3> rgb_to_ycbcr;
+    // Linear RGB <-> XYZ, for the standard's primaries.
+    std::array<double, 3 * 3> rgb_to_xyz;
+    std::array<double, 3 * 3> xyz_to_rgb;
+};
+
+// Source: ITU-R BT.601-7, ss. 2.5.1
+constexpr Coefficients bt601 = {"ITU-R BT.601-7",
+                                "bt601-7",
+                                {{1, 1.402, 0, 1, -0.714136, -0.344136, 1., 4.93315e-17, 1.772}},
+                                {{0.299, 0.587, 0.114, 0.701 / 1.402, -0.587 / 1.402, -0.114 / 1.402, -0.299 / 1.772, -0.587 / 1.772, 0.886 / 1.772}},
+                                rgb_to_xyz,
+                                xyz_to_rgb};
+
+// Source: ITU-R BT.709-6, ss. 3.3.
+// XXX: nudge these with xicclu?
+constexpr Coefficients bt709 = {
+    "ITU-R BT.709-6",
+    "bt709-6",
+    {{1, 0, 1.5748, 1, -0.187324, -0.468124, 1, 1.8556, -4.60823e-17}},
+    {{0.2126, 0.7152, 0.0722, -0.2126 / 1.8556, -0.7152 / 1.8556, 0.9278 / 1.8556, 0.7874 / 1.5748, -0.7152 / 1.5748, -0.0722 / 1.5748}},
+    rgb_to_xyz,
+    xyz_to_rgb};
+
+// Non-constant luminance. The OETF is the same as BT.709's.
+// Source: ITU-R BT.2020-2, table 4.
+constexpr Coefficients bt2020 = {
+    "ITU-R BT.2020-2",
+    "bt2020-2",
+    {{1, 0, 1.4746, 1, -0.164553, -0.571353, 1, 1.8814, 0}},
+    {{0.2627, 0.6780, 0.0593, -0.2627 / 1.8814, -0.6780 / 1.8814, 0.9407 / 1.8814, 0.7373 / 1.4746, -0.6780 / 1.4746, -0.0593 / 1.4746}},
+    bt2020_rgb_to_xyz,
+    bt2020_xyz_to_rgb};
+} // namespace ycbcr
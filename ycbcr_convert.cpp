@@ -0,0 +1,338 @@
+// SPDX-FileCopyrightText: 2022 Amyspark <amy@amyspark.me>
+// SPDX-License-Identifier: BSD-3-Clause
+
+#include "ycbcr_convert.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+namespace ycbcr
+{
+namespace scalar
+{
+struct Mask {
+    bool m;
+};
+
+struct Vec {
+    static constexpr size_t width = 1;
+
+    static Vec broadcast(float x)
+    {
+        return {x};
+    }
+
+    static Vec load(const float *p)
+    {
+        return {*p};
+    }
+
+    void store(float *p) const
+    {
+        *p = v;
+    }
+
+    float v;
+};
+
+Vec add(Vec a, Vec b)
+{
+    return {a.v + b.v};
+}
+
+Vec sub(Vec a, Vec b)
+{
+    return {a.v - b.v};
+}
+
+Vec mul(Vec a, Vec b)
+{
+    return {a.v * b.v};
+}
+
+Vec div(Vec a, Vec b)
+{
+    return {a.v / b.v};
+}
+
+// Same NaN handling as minps/maxps: the second operand wins.
+Vec min(Vec a, Vec b)
+{
+    return {a.v < b.v ? a.v : b.v};
+}
+
+Vec max(Vec a, Vec b)
+{
+    return {a.v > b.v ? a.v : b.v};
+}
+
+Mask cmpge(Vec a, Vec b)
+{
+    return {a.v >= b.v};
+}
+
+Vec select(Mask m, Vec a, Vec b)
+{
+    return m.m ? a : b;
+}
+
+Vec exponent(Vec x)
+{
+    uint32_t bits;
+    std::memcpy(&bits, &x.v, sizeof(bits));
+    return {static_cast<float>(static_cast<int32_t>(bits >> 23) - 127)};
+}
+
+Vec mantissa(Vec x)
+{
+    uint32_t bits;
+    std::memcpy(&bits, &x.v, sizeof(bits));
+    bits = (bits & 0x007FFFFF) | 0x3F800000;
+    float m;
+    std::memcpy(&m, &bits, sizeof(m));
+    return {m};
+}
+
+Vec round(Vec x)
+{
+    return {std::nearbyint(x.v)};
+}
+
+Vec pow2i(Vec n)
+{
+    const auto bits = static_cast<uint32_t>(static_cast<int32_t>(n.v) + 127) << 23;
+    float p;
+    std::memcpy(&p, &bits, sizeof(p));
+    return {p};
+}
+} // namespace scalar
+
+void convertBlockScalar(const KernelConstants &k, float *c0, float *c1, float *c2, size_t n)
+{
+    kernel::convertBlock<scalar::Vec>(k, c0, c1, c2, n);
+}
+
+namespace
+{
+// Pixels converted per kernel call.
+constexpr size_t blockSize = 256;
+
+bool cpuSupports(Isa isa)
+{
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+    __builtin_cpu_init();
+    switch (isa) {
+    case Isa::Scalar:
+        return true;
+    case Isa::SSE2:
+        return __builtin_cpu_supports("sse2");
+    case Isa::AVX2:
+        return __builtin_cpu_supports("avx2");
+    case Isa::AVX512:
+        return __builtin_cpu_supports("avx512f");
+    }
+    return false;
+#else
+    return isa == Isa::Scalar;
+#endif
+}
+
+BlockKernel builtKernel(Isa isa)
+{
+    switch (isa) {
+    case Isa::Scalar:
+        return convertBlockScalar;
+#ifdef YCBCR_HAVE_SSE2
+    case Isa::SSE2:
+        return convertBlockSSE2;
+#endif
+#ifdef YCBCR_HAVE_AVX2
+    case Isa::AVX2:
+        return convertBlockAVX2;
+#endif
+#ifdef YCBCR_HAVE_AVX512
+    case Isa::AVX512:
+        return convertBlockAVX512;
+#endif
+    default:
+        return nullptr;
+    }
+}
+
+// The BT.601/709 curves per ITU-R BT.709-6 ss. 1.2, and the BT.1886 EOTF.
+CurveSegments eotfSegments(Curve curve)
+{
+    if (curve == Curve::BT1886) {
+        return {0, 1, 0, static_cast<float>(bt1886Gamma), 1, 0, 0};
+    }
+    const auto &p = rec709ParametersInv;
+    return {static_cast<float>(p[4]), static_cast<float>(p[1]), static_cast<float>(p[2]), static_cast<float>(p[0]), 1, 0, static_cast<float>(p[3])};
+}
+
+CurveSegments oetfSegments(Curve curve)
+{
+    if (curve == Curve::BT1886) {
+        return {0, 1, 0, static_cast<float>(1.0 / bt1886Gamma), 1, 0, 0};
+    }
+    const auto &p = rec709Parameters;
+    return {static_cast<float>(p[4]), static_cast<float>(p[1]), static_cast<float>(p[2]), static_cast<float>(p[0]), 1, static_cast<float>(p[5]), static_cast<float>(p[3])};
+}
+
+float maxValue(SampleType type)
+{
+    switch (type) {
+    case SampleType::UInt8:
+        return 255.0f;
+    case SampleType::UInt10:
+        return 1023.0f;
+    case SampleType::UInt16:
+        return 65535.0f;
+    default:
+        return 1.0f;
+    }
+}
+
+template<typename T>
+void unpack(const T *in, size_t n, float maximum, float *c0, float *c1, float *c2)
+{
+    for (size_t i = 0; i < n; i++) {
+        c0[i] = static_cast<float>(in[i * 3]) / maximum;
+        c1[i] = static_cast<float>(in[i * 3 + 1]) / maximum;
+        c2[i] = static_cast<float>(in[i * 3 + 2]) / maximum;
+    }
+}
+
+template<typename T>
+T quantize(float v, float maximum)
+{
+    return static_cast<T>(std::min(std::max(v * maximum + 0.5f, 0.0f), maximum));
+}
+
+template<typename T>
+void pack(const float *c0, const float *c1, const float *c2, size_t n, float maximum, T *out)
+{
+    for (size_t i = 0; i < n; i++) {
+        out[i * 3] = quantize<T>(c0[i], maximum);
+        out[i * 3 + 1] = quantize<T>(c1[i], maximum);
+        out[i * 3 + 2] = quantize<T>(c2[i], maximum);
+    }
+}
+
+template<>
+void pack(const float *c0, const float *c1, const float *c2, size_t n, float, float *out)
+{
+    for (size_t i = 0; i < n; i++) {
+        out[i * 3] = c0[i];
+        out[i * 3 + 1] = c1[i];
+        out[i * 3 + 2] = c2[i];
+    }
+}
+
+template<typename T>
+void convertSamples(BlockKernel kernel, const KernelConstants &k, const T *in, T *out, size_t count, float maximum)
+{
+    // The kernels may run past the end of a partial block, into the
+    // (initialized) rest of the buffers.
+    alignas(64) std::array<float, blockSize> c0{}, c1{}, c2{};
+    for (size_t done = 0; done < count; done += blockSize) {
+        const auto n = std::min(blockSize, count - done);
+        unpack(in + done * 3, n, maximum, c0.data(), c1.data(), c2.data());
+        kernel(k, c0.data(), c1.data(), c2.data(), n);
+        pack(c0.data(), c1.data(), c2.data(), n, maximum, out + done * 3);
+    }
+}
+} // namespace
+
+bool isaSupported(Isa isa)
+{
+    return builtKernel(isa) && cpuSupports(isa);
+}
+
+Isa bestIsa()
+{
+    for (const auto isa : {Isa::AVX512, Isa::AVX2, Isa::SSE2}) {
+        if (isaSupported(isa)) {
+            return isa;
+        }
+    }
+    return Isa::Scalar;
+}
+
+const char *isaName(Isa isa)
+{
+    switch (isa) {
+    case Isa::SSE2:
+        return "sse2";
+    case Isa::AVX2:
+        return "avx2";
+    case Isa::AVX512:
+        return "avx512";
+    default:
+        return "scalar";
+    }
+}
+
+Converter::Converter(const ConverterParams &params, Isa isa)
+    : kernelIsa(isaSupported(isa) ? isa : bestIsa())
+    , kernel(builtKernel(kernelIsa))
+    , decode()
+    , encode()
+{
+    const auto &c = coefficients(params.standard);
+    const auto range = rangeMapping(params.range);
+
+    // YCbCr -> R'G'B', with the range mapping folded into the matrix.
+    for (size_t i = 0; i < 3; i++) {
+        double offset = 0;
+        for (size_t j = 0; j < 3; j++) {
+            decode.matrix[i * 3 + j] = static_cast<float>(c.ycbcr_to_rgb[i * 3 + j] * range.scale[j]);
+            offset += c.ycbcr_to_rgb[i * 3 + j] * range.offset[j];
+        }
+        decode.offset[i] = static_cast<float>(offset);
+    }
+    decode.hasCurve = params.linear && !isHDR(params.curve);
+    decode.curveFirst = false;
+    decode.curve = eotfSegments(params.curve);
+
+    // R'G'B' -> YCbCr, followed by the inverse of the range mapping.
+    for (size_t i = 0; i < 3; i++) {
+        for (size_t j = 0; j < 3; j++) {
+            encode.matrix[i * 3 + j] = static_cast<float>(c.rgb_to_ycbcr[i * 3 + j] / range.scale[i]);
+        }
+        encode.offset[i] = static_cast<float>(-range.offset[i] / range.scale[i]);
+    }
+    encode.hasCurve = params.linear && !isHDR(params.curve);
+    encode.curveFirst = true;
+    encode.curve = oetfSegments(params.curve);
+}
+
+void Converter::toRGB(const void *in, void *out, size_t count, SampleType type) const
+{
+    convert(decode, in, out, count, type);
+}
+
+void Converter::toYCbCr(const void *in, void *out, size_t count, SampleType type) const
+{
+    convert(encode, in, out, count, type);
+}
+
+void Converter::convert(const KernelConstants &constants, const void *in, void *out, size_t count, SampleType type) const
+{
+    const auto maximum = maxValue(type);
+    switch (type) {
+    case SampleType::UInt8:
+        convertSamples(kernel, constants, static_cast<const uint8_t *>(in), static_cast<uint8_t *>(out), count, maximum);
+        break;
+    case SampleType::UInt10:
+    case SampleType::UInt16:
+        convertSamples(kernel, constants, static_cast<const uint16_t *>(in), static_cast<uint16_t *>(out), count, maximum);
+        break;
+    case SampleType::Float:
+        convertSamples(kernel, constants, static_cast<const float *>(in), static_cast<float *>(out), count, maximum);
+        break;
+    }
+}
+} // namespace ycbcr
@@ -0,0 +1,70 @@
+// SPDX-FileCopyrightText: 2022 Amyspark <amy@amyspark.me>
+// SPDX-License-Identifier: BSD-3-Clause
+
+#pragma once
+
+#include <cstddef>
+
+#include "ycbcr_convert_kernel.h"
+#include "ycbcr_profile.h"
+
+namespace ycbcr
+{
+// Storage of each channel. 10-bit samples sit in the low bits of 16-bit
+// words. Integer samples are normalized like in the profiles: 0 to 2^n - 1
+// maps to [0, 1], before the range mapping.
+enum class SampleType { UInt8, UInt10, UInt16, Float };
+
+enum class Isa { Scalar, SSE2, AVX2, AVX512 };
+
+// The widest instruction set that is both built in and supported by the
+// CPU.
+Isa bestIsa();
+
+// Whether the kernels for isa are built in and supported by the CPU.
+bool isaSupported(Isa isa);
+
+const char *isaName(Isa isa);
+
+struct ConverterParams {
+    Standard standard = Standard::BT709;
+    Curve curve = Curve::OETF;
+    // If set, the RGB side is linear light (the transfer curve is applied),
+    // otherwise it's the non-linear R'G'B' the YCbCr is computed from. The
+    // kernels have no PQ or HLG curve: with those, it's always R'G'B'.
+    bool linear = false;
+    // Quantization range of the YCbCr samples.
+    Range range = Range::Full;
+};
+
+// Converts between YCbCr and RGB with the same matrices, offsets and curves
+// the profiles are built from, without going through any CLUT. Pixels are
+// three interleaved channels, in the order the profiles use.
+//
+// The math is done in single precision, by SIMD kernels chosen at runtime;
+// the scalar fallback runs the same code one pixel at a time.
+class Converter
+{
+public:
+    // An isa not supported by the build or CPU falls back to the best one.
+    explicit Converter(const ConverterParams &params, Isa isa = bestIsa());
+
+    Isa isa() const
+    {
+        return kernelIsa;
+    }
+
+    // in and out hold count pixels of the given type, and may be the same
+    // buffer. Float samples are neither clamped nor rounded.
+    void toRGB(const void *in, void *out, size_t count, SampleType type) const;
+    void toYCbCr(const void *in, void *out, size_t count, SampleType type) const;
+
+private:
+    void convert(const KernelConstants &constants, const void *in, void *out, size_t count, SampleType type) const;
+
+    Isa kernelIsa;
+    BlockKernel kernel;
+    KernelConstants decode;
+    KernelConstants encode;
+};
+} // namespace ycbcr
@@ -0,0 +1,105 @@
+// SPDX-FileCopyrightText: 2022 Amyspark <amy@amyspark.me>
+// SPDX-License-Identifier: BSD-3-Clause
+
+#include "ycbcr_convert_kernel.h"
+
+#include <immintrin.h>
+
+namespace ycbcr
+{
+namespace avx2
+{
+struct Mask {
+    __m256 m;
+};
+
+struct Vec {
+    static constexpr size_t width = 8;
+
+    static Vec broadcast(float x)
+    {
+        return {_mm256_set1_ps(x)};
+    }
+
+    static Vec load(const float *p)
+    {
+        return {_mm256_loadu_ps(p)};
+    }
+
+    void store(float *p) const
+    {
+        _mm256_storeu_ps(p, v);
+    }
+
+    __m256 v;
+};
+
+Vec add(Vec a, Vec b)
+{
+    return {_mm256_add_ps(a.v, b.v)};
+}
+
+Vec sub(Vec a, Vec b)
+{
+    return {_mm256_sub_ps(a.v, b.v)};
+}
+
+Vec mul(Vec a, Vec b)
+{
+    return {_mm256_mul_ps(a.v, b.v)};
+}
+
+Vec div(Vec a, Vec b)
+{
+    return {_mm256_div_ps(a.v, b.v)};
+}
+
+Vec min(Vec a, Vec b)
+{
+    return {_mm256_min_ps(a.v, b.v)};
+}
+
+Vec max(Vec a, Vec b)
+{
+    return {_mm256_max_ps(a.v, b.v)};
+}
+
+Mask cmpge(Vec a, Vec b)
+{
+    return {_mm256_cmp_ps(a.v, b.v, _CMP_GE_OQ)};
+}
+
+Vec select(Mask m, Vec a, Vec b)
+{
+    return {_mm256_blendv_ps(b.v, a.v, m.m)};
+}
+
+Vec exponent(Vec x)
+{
+    const auto biased = _mm256_srli_epi32(_mm256_castps_si256(x.v), 23);
+    return {_mm256_cvtepi32_ps(_mm256_sub_epi32(biased, _mm256_set1_epi32(127)))};
+}
+
+Vec mantissa(Vec x)
+{
+    const auto bits = _mm256_and_si256(_mm256_castps_si256(x.v), _mm256_set1_epi32(0x007FFFFF));
+    return {_mm256_castsi256_ps(_mm256_or_si256(bits, _mm256_set1_epi32(0x3F800000)))};
+}
+
+Vec round(Vec x)
+{
+    return {_mm256_cvtepi32_ps(_mm256_cvtps_epi32(x.v))};
+}
+
+Vec pow2i(Vec n)
+{
+    const auto biased = _mm256_add_epi32(_mm256_cvtps_epi32(n.v), _mm256_set1_epi32(127));
+    return {_mm256_castsi256_ps(_mm256_slli_epi32(biased, 23))};
+}
+} // namespace avx2
+
+void convertBlockAVX2(const KernelConstants &k, float *c0, float *c1, float *c2, size_t n)
+{
+    kernel::convertBlock<avx2::Vec>(k, c0, c1, c2, n);
+}
+} // namespace ycbcr
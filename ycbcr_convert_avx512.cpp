@@ -0,0 +1,111 @@
+// SPDX-FileCopyrightText: 2022 Amyspark <amy@amyspark.me>
+// SPDX-License-Identifier: BSD-3-Clause
+
+#include "ycbcr_convert_kernel.h"
+
+// GCC 12 warns about the _mm512_undefined_* placeholders inside its own
+// intrinsics.
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic ignored "-Wuninitialized"
+#endif
+
+#include <immintrin.h>
+
+namespace ycbcr
+{
+namespace avx512
+{
+struct Mask {
+    __mmask16 m;
+};
+
+struct Vec {
+    static constexpr size_t width = 16;
+
+    static Vec broadcast(float x)
+    {
+        return {_mm512_set1_ps(x)};
+    }
+
+    static Vec load(const float *p)
+    {
+        return {_mm512_loadu_ps(p)};
+    }
+
+    void store(float *p) const
+    {
+        _mm512_storeu_ps(p, v);
+    }
+
+    __m512 v;
+};
+
+Vec add(Vec a, Vec b)
+{
+    return {_mm512_add_ps(a.v, b.v)};
+}
+
+Vec sub(Vec a, Vec b)
+{
+    return {_mm512_sub_ps(a.v, b.v)};
+}
+
+Vec mul(Vec a, Vec b)
+{
+    return {_mm512_mul_ps(a.v, b.v)};
+}
+
+Vec div(Vec a, Vec b)
+{
+    return {_mm512_div_ps(a.v, b.v)};
+}
+
+Vec min(Vec a, Vec b)
+{
+    return {_mm512_min_ps(a.v, b.v)};
+}
+
+Vec max(Vec a, Vec b)
+{
+    return {_mm512_max_ps(a.v, b.v)};
+}
+
+Mask cmpge(Vec a, Vec b)
+{
+    return {_mm512_cmp_ps_mask(a.v, b.v, _CMP_GE_OQ)};
+}
+
+Vec select(Mask m, Vec a, Vec b)
+{
+    return {_mm512_mask_blend_ps(m.m, b.v, a.v)};
+}
+
+Vec exponent(Vec x)
+{
+    const auto biased = _mm512_srli_epi32(_mm512_castps_si512(x.v), 23);
+    return {_mm512_cvtepi32_ps(_mm512_sub_epi32(biased, _mm512_set1_epi32(127)))};
+}
+
+Vec mantissa(Vec x)
+{
+    const auto bits = _mm512_and_si512(_mm512_castps_si512(x.v), _mm512_set1_epi32(0x007FFFFF));
+    return {_mm512_castsi512_ps(_mm512_or_si512(bits, _mm512_set1_epi32(0x3F800000)))};
+}
+
+Vec round(Vec x)
+{
+    return {_mm512_cvtepi32_ps(_mm512_cvtps_epi32(x.v))};
+}
+
+Vec pow2i(Vec n)
+{
+    const auto biased = _mm512_add_epi32(_mm512_cvtps_epi32(n.v), _mm512_set1_epi32(127));
+    return {_mm512_castsi512_ps(_mm512_slli_epi32(biased, 23))};
+}
+} // namespace avx512
+
+void convertBlockAVX512(const KernelConstants &k, float *c0, float *c1, float *c2, size_t n)
+{
+    kernel::convertBlock<avx512::Vec>(k, c0, c1, c2, n);
+}
+} // namespace ycbcr
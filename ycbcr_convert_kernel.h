@@ -0,0 +1,138 @@
+// SPDX-FileCopyrightText: 2022 Amyspark <amy@amyspark.me>
+// SPDX-License-Identifier: BSD-3-Clause
+
+#pragma once
+
+#include <cstddef>
+
+// The arithmetic of the converter, written once against a small vector
+// interface and instantiated for each instruction set. A vector type V
+// provides:
+//
+//   V::width, V::broadcast(float), V::load(const float *), v.store(float *)
+//   add, sub, mul, div, min, max, cmpge, select(mask, ifTrue, ifFalse)
+//   exponent(x) and mantissa(x): x = mantissa * 2^exponent, for normal
+//                                x > 0, with the mantissa in [1, 2)
+//   round(x):                    nearest integer, ties to even
+//   pow2i(n):                    2^n, for integral n in [-126, 127]
+//
+// Only IEEE operations are used, in a fixed order, so every instruction set
+// produces the same results as the scalar fallback, as long as the compiler
+// doesn't contract them into FMAs (-ffp-contract=off).
+
+namespace ycbcr
+{
+// scale * (a * x + b) ^ gamma + offset for x >= threshold, slope * x
+// otherwise.
+struct CurveSegments {
+    float threshold;
+    float a;
+    float b;
+    float gamma;
+    float scale;
+    float offset;
+    float slope;
+};
+
+// One direction of the conversion: the curve (if any) is applied before the
+// affine transform when encoding, after it when decoding.
+struct KernelConstants {
+    float matrix[3 * 3];
+    float offset[3];
+    bool hasCurve;
+    bool curveFirst;
+    CurveSegments curve;
+};
+
+// Converts n pixels in place, stored as one array per channel. The arrays
+// must have room for n rounded up to a multiple of 16.
+using BlockKernel = void (*)(const KernelConstants &k, float *c0, float *c1, float *c2, size_t n);
+
+void convertBlockScalar(const KernelConstants &k, float *c0, float *c1, float *c2, size_t n);
+void convertBlockSSE2(const KernelConstants &k, float *c0, float *c1, float *c2, size_t n);
+void convertBlockAVX2(const KernelConstants &k, float *c0, float *c1, float *c2, size_t n);
+void convertBlockAVX512(const KernelConstants &k, float *c0, float *c1, float *c2, size_t n);
+
+namespace kernel
+{
+// Smallest normal float, so that log2 never sees zero or a denormal.
+constexpr float minNormal = 1.17549435e-38f;
+
+template<typename V>
+V log2Positive(V x)
+{
+    auto e = exponent(x);
+    auto m = mantissa(x);
+    // Move the mantissa to [sqrt(0.5), sqrt(2)) for faster convergence.
+    const auto big = cmpge(m, V::broadcast(1.41421356f));
+    m = select(big, mul(m, V::broadcast(0.5f)), m);
+    e = select(big, add(e, V::broadcast(1.0f)), e);
+    // ln(m) = 2 atanh(s), s = (m - 1) / (m + 1), |s| < 0.172
+    const auto s = div(sub(m, V::broadcast(1.0f)), add(m, V::broadcast(1.0f)));
+    const auto s2 = mul(s, s);
+    auto p = V::broadcast(1.0f / 11.0f);
+    p = add(mul(p, s2), V::broadcast(1.0f / 9.0f));
+    p = add(mul(p, s2), V::broadcast(1.0f / 7.0f));
+    p = add(mul(p, s2), V::broadcast(1.0f / 5.0f));
+    p = add(mul(p, s2), V::broadcast(1.0f / 3.0f));
+    p = add(mul(p, s2), V::broadcast(1.0f));
+    const auto ln = mul(mul(V::broadcast(2.0f), s), p);
+    return add(e, mul(ln, V::broadcast(1.44269504f)));
+}
+
+template<typename V>
+V exp2(V y)
+{
+    y = min(max(y, V::broadcast(-126.0f)), V::broadcast(127.0f));
+    const auto n = round(y);
+    // e^t, |t| <= ln(2) / 2
+    const auto t = mul(sub(y, n), V::broadcast(0.693147181f));
+    auto p = V::broadcast(1.0f / 5040.0f);
+    p = add(mul(p, t), V::broadcast(1.0f / 720.0f));
+    p = add(mul(p, t), V::broadcast(1.0f / 120.0f));
+    p = add(mul(p, t), V::broadcast(1.0f / 24.0f));
+    p = add(mul(p, t), V::broadcast(1.0f / 6.0f));
+    p = add(mul(p, t), V::broadcast(0.5f));
+    p = add(mul(p, t), V::broadcast(1.0f));
+    p = add(mul(p, t), V::broadcast(1.0f));
+    return mul(p, pow2i(n));
+}
+
+template<typename V>
+V applyCurve(const CurveSegments &c, V x)
+{
+    const auto base = max(add(mul(V::broadcast(c.a), x), V::broadcast(c.b)), V::broadcast(minNormal));
+    const auto power = exp2(mul(V::broadcast(c.gamma), log2Positive(base)));
+    const auto upper = add(mul(V::broadcast(c.scale), power), V::broadcast(c.offset));
+    const auto lower = mul(V::broadcast(c.slope), x);
+    return select(cmpge(x, V::broadcast(c.threshold)), upper, lower);
+}
+
+template<typename V>
+void convertBlock(const KernelConstants &k, float *c0, float *c1, float *c2, size_t n)
+{
+    for (size_t i = 0; i < n; i += V::width) {
+        auto x0 = V::load(c0 + i);
+        auto x1 = V::load(c1 + i);
+        auto x2 = V::load(c2 + i);
+        if (k.hasCurve && k.curveFirst) {
+            x0 = applyCurve(k.curve, x0);
+            x1 = applyCurve(k.curve, x1);
+            x2 = applyCurve(k.curve, x2);
+        }
+        const auto *m = k.matrix;
+        auto y0 = add(add(add(mul(V::broadcast(m[0]), x0), mul(V::broadcast(m[1]), x1)), mul(V::broadcast(m[2]), x2)), V::broadcast(k.offset[0]));
+        auto y1 = add(add(add(mul(V::broadcast(m[3]), x0), mul(V::broadcast(m[4]), x1)), mul(V::broadcast(m[5]), x2)), V::broadcast(k.offset[1]));
+        auto y2 = add(add(add(mul(V::broadcast(m[6]), x0), mul(V::broadcast(m[7]), x1)), mul(V::broadcast(m[8]), x2)), V::broadcast(k.offset[2]));
+        if (k.hasCurve && !k.curveFirst) {
+            y0 = applyCurve(k.curve, y0);
+            y1 = applyCurve(k.curve, y1);
+            y2 = applyCurve(k.curve, y2);
+        }
+        y0.store(c0 + i);
+        y1.store(c1 + i);
+        y2.store(c2 + i);
+    }
+}
+} // namespace kernel
+} // namespace ycbcr
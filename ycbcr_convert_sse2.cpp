@@ -0,0 +1,105 @@
+// SPDX-FileCopyrightText: 2022 Amyspark <amy@amyspark.me>
+// SPDX-License-Identifier: BSD-3-Clause
+
+#include "ycbcr_convert_kernel.h"
+
+#include <emmintrin.h>
+
+namespace ycbcr
+{
+namespace sse2
+{
+struct Mask {
+    __m128 m;
+};
+
+struct Vec {
+    static constexpr size_t width = 4;
+
+    static Vec broadcast(float x)
+    {
+        return {_mm_set1_ps(x)};
+    }
+
+    static Vec load(const float *p)
+    {
+        return {_mm_loadu_ps(p)};
+    }
+
+    void store(float *p) const
+    {
+        _mm_storeu_ps(p, v);
+    }
+
+    __m128 v;
+};
+
+Vec add(Vec a, Vec b)
+{
+    return {_mm_add_ps(a.v, b.v)};
+}
+
+Vec sub(Vec a, Vec b)
+{
+    return {_mm_sub_ps(a.v, b.v)};
+}
+
+Vec mul(Vec a, Vec b)
+{
+    return {_mm_mul_ps(a.v, b.v)};
+}
+
+Vec div(Vec a, Vec b)
+{
+    return {_mm_div_ps(a.v, b.v)};
+}
+
+Vec min(Vec a, Vec b)
+{
+    return {_mm_min_ps(a.v, b.v)};
+}
+
+Vec max(Vec a, Vec b)
+{
+    return {_mm_max_ps(a.v, b.v)};
+}
+
+Mask cmpge(Vec a, Vec b)
+{
+    return {_mm_cmpge_ps(a.v, b.v)};
+}
+
+Vec select(Mask m, Vec a, Vec b)
+{
+    return {_mm_or_ps(_mm_and_ps(m.m, a.v), _mm_andnot_ps(m.m, b.v))};
+}
+
+Vec exponent(Vec x)
+{
+    const auto biased = _mm_srli_epi32(_mm_castps_si128(x.v), 23);
+    return {_mm_cvtepi32_ps(_mm_sub_epi32(biased, _mm_set1_epi32(127)))};
+}
+
+Vec mantissa(Vec x)
+{
+    const auto bits = _mm_and_si128(_mm_castps_si128(x.v), _mm_set1_epi32(0x007FFFFF));
+    return {_mm_castsi128_ps(_mm_or_si128(bits, _mm_set1_epi32(0x3F800000)))};
+}
+
+Vec round(Vec x)
+{
+    return {_mm_cvtepi32_ps(_mm_cvtps_epi32(x.v))};
+}
+
+Vec pow2i(Vec n)
+{
+    const auto biased = _mm_add_epi32(_mm_cvtps_epi32(n.v), _mm_set1_epi32(127));
+    return {_mm_castsi128_ps(_mm_slli_epi32(biased, 23))};
+}
+} // namespace sse2
+
+void convertBlockSSE2(const KernelConstants &k, float *c0, float *c1, float *c2, size_t n)
+{
+    kernel::convertBlock<sse2::Vec>(k, c0, c1, c2, n);
+}
+} // namespace ycbcr
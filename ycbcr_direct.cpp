@@ -0,0 +1,305 @@
+// SPDX-FileCopyrightText: 2022 Amyspark <amy@amyspark.me>
+// SPDX-License-Identifier: BSD-3-Clause
+
+#include "ycbcr_direct.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <thread>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "ycbcr_profile.h"
+
+namespace ycbcr
+{
+namespace
+{
+// Layout of the file header, in bytes. The integers are little endian.
+constexpr std::array<char, 8> magic = {'Y', 'C', 'C', 'L', 'U', 'T', '8', '\0'};
+constexpr size_t versionOffset = 8;
+constexpr size_t methodOffset = 12;
+constexpr size_t yCbCrIDOffset = 16;
+constexpr size_t rgbIDOffset = 32;
+// The table starts at a cache line boundary.
+constexpr size_t headerSize = 64;
+
+// Position of the creation date in the ICC header.
+constexpr size_t creationDateOffset = 24;
+constexpr size_t creationDateSize = 12;
+
+// Inputs per work item: every Cb and Cr for one Y.
+constexpr size_t sliceSize = 256 * 256;
+
+void putUInt32(std::array<cmsUInt8Number, headerSize> &header, size_t offset, cmsUInt32Number value)
+{
+    for (size_t i = 0; i < 4; i++) {
+        header[offset + i] = static_cast<cmsUInt8Number>(value >> (8 * i));
+    }
+}
+
+cmsUInt32Number getUInt32(const cmsUInt8Number *header, size_t offset)
+{
+    cmsUInt32Number value = 0;
+    for (size_t i = 0; i < 4; i++) {
+        value |= static_cast<cmsUInt32Number>(header[offset + i]) << (8 * i);
+    }
+    return value;
+}
+
+std::string hex(const ProfileID &id)
+{
+    static const char digits[] = "0123456789abcdef";
+    std::string text;
+    for (const auto byte : id) {
+        text += digits[byte >> 4];
+        text += digits[byte & 0xF];
+    }
+    return text;
+}
+
+// Fills the slices of the table for the Y values handed out by next.
+void buildSlices(cmsHTRANSFORM transform, DirectLutMethod method, std::atomic<size_t> &next, std::vector<cmsUInt8Number> &table)
+{
+    std::vector<cmsUInt8Number> input(sliceSize * 3);
+    std::vector<cmsFloat32Number> inputFloat(method == DirectLutMethod::Exact ? sliceSize * 3 : 0);
+    std::vector<cmsFloat32Number> outputFloat(inputFloat.size());
+    for (auto y = next++; y < 256; y = next++) {
+        auto *output = table.data() + y * sliceSize * 3;
+        for (size_t i = 0; i < sliceSize; i++) {
+            input[3 * i] = static_cast<cmsUInt8Number>(y);
+            input[3 * i + 1] = static_cast<cmsUInt8Number>(i >> 8);
+            input[3 * i + 2] = static_cast<cmsUInt8Number>(i);
+        }
+        if (method == DirectLutMethod::Transform) {
+            cmsDoTransform(transform, input.data(), output, sliceSize);
+            continue;
+        }
+        for (size_t i = 0; i < input.size(); i++) {
+            inputFloat[i] = static_cast<cmsFloat32Number>(input[i]) / 255.0f;
+        }
+        cmsDoTransform(transform, inputFloat.data(), outputFloat.data(), sliceSize);
+        for (size_t i = 0; i < outputFloat.size(); i++) {
+            output[i] = static_cast<cmsUInt8Number>(std::lround(std::min(std::max(outputFloat[i], 0.0f), 1.0f) * 255.0f));
+        }
+    }
+}
+} // namespace
+
+ProfileID profileID(cmsHPROFILE profile)
+{
+    ProfileID id{};
+    cmsGetHeaderProfileID(profile, id.data());
+    if (std::any_of(id.begin(), id.end(), [](cmsUInt8Number byte) {
+            return byte != 0;
+        })) {
+        return id;
+    }
+
+    // Profiles built at run time carry the time they were created in, which
+    // the MD5 covers; compute it on a copy without it.
+    cmsUInt32Number size = 0;
+    if (!cmsSaveProfileToMem(profile, nullptr, &size)) {
+        return id;
+    }
+    std::vector<cmsUInt8Number> bytes(size);
+    if (!cmsSaveProfileToMem(profile, bytes.data(), &size) || size < creationDateOffset + creationDateSize) {
+        return id;
+    }
+    std::fill_n(bytes.begin() + creationDateOffset, creationDateSize, 0);
+    auto copy = cmsOpenProfileFromMemTHR(cmsGetProfileContextID(profile), bytes.data(), size);
+    if (copy) {
+        cmsMD5computeID(copy);
+        cmsGetHeaderProfileID(copy, id.data());
+        cmsCloseProfile(copy);
+    }
+    return id;
+}
+
+std::string directLutName(cmsHPROFILE yCbCr, cmsHPROFILE rgb)
+{
+    return hex(profileID(yCbCr)) + "_" + hex(profileID(rgb)) + ".ycclut";
+}
+
+std::vector<cmsUInt8Number> buildDirectLut(cmsContext ctx, cmsHPROFILE yCbCr, cmsHPROFILE rgb, DirectLutMethod method, unsigned int threads)
+{
+    // LittleCMS would fall back to the interpolated AToB0 CLUT.
+    if (method == DirectLutMethod::Exact && !cmsIsTag(yCbCr, cmsSigDToB0Tag)) {
+        std::cerr << "The exact method needs a profile with a DToB0 tag, i.e. a v4 one" << std::endl;
+        return {};
+    }
+
+    auto transform = method == DirectLutMethod::Exact
+        ? cmsCreateTransformTHR(ctx, yCbCr, TYPE_YCbCr_FLT, rgb, TYPE_RGB_FLT, INTENT_PERCEPTUAL, cmsFLAGS_NOOPTIMIZE | cmsFLAGS_NOCACHE)
+        : cmsCreateTransformTHR(ctx, yCbCr, TYPE_YCbCr_8, rgb, TYPE_RGB_8, INTENT_PERCEPTUAL, 0);
+    if (!transform) {
+        std::cerr << "Cannot create the transform" << std::endl;
+        return {};
+    }
+
+    std::vector<cmsUInt8Number> table(directLutBytes);
+    std::atomic<size_t> next{0};
+    std::vector<std::thread> workers;
+    for (unsigned int i = 1; i < threads; i++) {
+        workers.emplace_back(buildSlices, transform, method, std::ref(next), std::ref(table));
+    }
+    buildSlices(transform, method, next, table);
+    for (auto &t : workers) {
+        t.join();
+    }
+
+    cmsDeleteTransform(transform);
+    return table;
+}
+
+bool writeDirectLut(const std::string &path, cmsHPROFILE yCbCr, cmsHPROFILE rgb, DirectLutMethod method, const std::vector<cmsUInt8Number> &table)
+{
+    if (table.size() != directLutBytes) {
+        return false;
+    }
+
+    std::array<cmsUInt8Number, headerSize> header{};
+    std::copy(magic.begin(), magic.end(), header.begin());
+    putUInt32(header, versionOffset, directLutVersion);
+    putUInt32(header, methodOffset, static_cast<cmsUInt32Number>(method));
+    const auto yCbCrID = profileID(yCbCr);
+    const auto rgbID = profileID(rgb);
+    std::copy(yCbCrID.begin(), yCbCrID.end(), header.begin() + yCbCrIDOffset);
+    std::copy(rgbID.begin(), rgbID.end(), header.begin() + rgbIDOffset);
+
+    std::ofstream file(path, std::ios::binary);
+    file.write(reinterpret_cast<const char *>(header.data()), static_cast<std::streamsize>(header.size()));
+    file.write(reinterpret_cast<const char *>(table.data()), static_cast<std::streamsize>(table.size()));
+    file.flush();
+    if (!file) {
+        std::cerr << "CANNOT WRITE " << path << std::endl;
+        return false;
+    }
+    return true;
+}
+
+DirectLut::~DirectLut()
+{
+    close();
+}
+
+bool DirectLut::open(const std::string &path, cmsHPROFILE yCbCr, cmsHPROFILE rgb)
+{
+    close();
+
+#ifdef _WIN32
+    auto file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE) {
+        std::cerr << "Cannot open " << path << std::endl;
+        return false;
+    }
+    LARGE_INTEGER fileSize{};
+    auto fileMapping = GetFileSizeEx(file, &fileSize) ? CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr) : nullptr;
+    CloseHandle(file);
+    if (!fileMapping) {
+        std::cerr << "Cannot map " << path << std::endl;
+        return false;
+    }
+    // The view keeps the mapping alive.
+    mapping = MapViewOfFile(fileMapping, FILE_MAP_READ, 0, 0, 0);
+    CloseHandle(fileMapping);
+    size = static_cast<size_t>(fileSize.QuadPart);
+#else
+    const auto fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        std::cerr << "Cannot open " << path << std::endl;
+        return false;
+    }
+    struct stat info {
+    };
+    if (fstat(fd, &info) == 0 && info.st_size > 0) {
+        size = static_cast<size_t>(info.st_size);
+        mapping = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+        if (mapping == MAP_FAILED) {
+            mapping = nullptr;
+        }
+    }
+    ::close(fd);
+#endif
+    if (!mapping) {
+        std::cerr << "Cannot map " << path << std::endl;
+        size = 0;
+        return false;
+    }
+
+    const auto *header = static_cast<const cmsUInt8Number *>(mapping);
+    if (size != headerSize + directLutBytes || !std::equal(magic.begin(), magic.end(), header)) {
+        std::cerr << path << " is not a direct LUT" << std::endl;
+        close();
+        return false;
+    }
+    if (getUInt32(header, versionOffset) != directLutVersion) {
+        std::cerr << path << " has version " << getUInt32(header, versionOffset) << ", expected " << directLutVersion << std::endl;
+        close();
+        return false;
+    }
+    const auto yCbCrID = profileID(yCbCr);
+    const auto rgbID = profileID(rgb);
+    if (!std::equal(yCbCrID.begin(), yCbCrID.end(), header + yCbCrIDOffset) || !std::equal(rgbID.begin(), rgbID.end(), header + rgbIDOffset)) {
+        std::cerr << path << " was built for other profiles" << std::endl;
+        close();
+        return false;
+    }
+
+    const auto method = getUInt32(header, methodOffset);
+    if (method != static_cast<cmsUInt32Number>(DirectLutMethod::Exact) && method != static_cast<cmsUInt32Number>(DirectLutMethod::Transform)) {
+        std::cerr << path << " has an unknown method " << method << std::endl;
+        close();
+        return false;
+    }
+
+    tableMethod = static_cast<DirectLutMethod>(method);
+    table = header + headerSize;
+    return true;
+}
+
+void DirectLut::close()
+{
+    if (mapping) {
+#ifdef _WIN32
+        UnmapViewOfFile(mapping);
+#else
+        munmap(mapping, size);
+#endif
+    }
+    mapping = nullptr;
+    size = 0;
+    table = nullptr;
+}
+
+bool DirectLut::isOpen() const
+{
+    return table != nullptr;
+}
+
+DirectLutMethod DirectLut::method() const
+{
+    return tableMethod;
+}
+
+void DirectLut::convert(const cmsUInt8Number *input, cmsUInt8Number *output, size_t pixels) const
+{
+    for (size_t i = 0; i < pixels; i++, input += 3, output += 3) {
+        const auto *entry = table + 3 * (static_cast<size_t>(input[0]) << 16 | static_cast<size_t>(input[1]) << 8 | input[2]);
+        output[0] = entry[0];
+        output[1] = entry[1];
+        output[2] = entry[2];
+    }
+}
+} // namespace ycbcr
@@ -0,0 +1,86 @@
+// SPDX-FileCopyrightText: 2022 Amyspark <amy@amyspark.me>
+// SPDX-License-Identifier: BSD-3-Clause
+
+#pragma once
+
+#include <lcms2.h>
+
+#include <array>
+#include <cstddef>
+#include <string>
+#include <vector>
+
+namespace ycbcr
+{
+// An exhaustive table of an 8-bit YCbCr -> 8-bit RGB transform: the RGB
+// triplet of each of the 2^24 inputs, indexed by Y << 16 | Cb << 8 | Cr,
+// 48 MiB in all.
+constexpr size_t directLutEntries = size_t{1} << 24;
+constexpr size_t directLutBytes = directLutEntries * 3;
+
+// Bumped whenever the file layout changes; older files are rejected.
+constexpr cmsUInt32Number directLutVersion = 1;
+
+enum class DirectLutMethod {
+    // A floating point transform with cmsFLAGS_NOOPTIMIZE, i.e. through the
+    // DToB0 pipeline of the v4 profiles, rounded to 8 bits. v2 profiles,
+    // which have no DToB0, are rejected.
+    Exact,
+    // The 8-bit transform LittleCMS creates by default.
+    Transform,
+};
+
+using ProfileID = std::array<cmsUInt8Number, 16>;
+
+// The profile's MD5, as computed by cmsMD5computeID. If the header holds
+// none, it's computed with the creation date zeroed, so that profiles built
+// at run time, such as the displays', always get the same one.
+ProfileID profileID(cmsHPROFILE profile);
+
+// The table's file name, keyed by the MD5 of both profiles:
+// <YCbCr MD5>_<RGB MD5>.ycclut, in hexadecimal.
+std::string directLutName(cmsHPROFILE yCbCr, cmsHPROFILE rgb);
+
+// Evaluates the transform from yCbCr to rgb for every input, on the given
+// number of threads. Returns an empty table on failure, including the exact
+// method with a profile without DToB0.
+std::vector<cmsUInt8Number> buildDirectLut(cmsContext ctx, cmsHPROFILE yCbCr, cmsHPROFILE rgb, DirectLutMethod method, unsigned int threads);
+
+// Writes the table, after a header with its version, method and the MD5 of
+// both profiles.
+bool writeDirectLut(const std::string &path, cmsHPROFILE yCbCr, cmsHPROFILE rgb, DirectLutMethod method, const std::vector<cmsUInt8Number> &table);
+
+// A table written by writeDirectLut, memory mapped read-only. Every process
+// that maps the same file shares its pages.
+class DirectLut
+{
+public:
+    DirectLut() = default;
+    ~DirectLut();
+
+    DirectLut(const DirectLut &) = delete;
+    DirectLut &operator=(const DirectLut &) = delete;
+
+    // Maps the file, unmapping the previous one. Returns false if it can't
+    // be mapped, is malformed, has another version, or was built for other
+    // profiles.
+    bool open(const std::string &path, cmsHPROFILE yCbCr, cmsHPROFILE rgb);
+
+    void close();
+
+    bool isOpen() const;
+
+    DirectLutMethod method() const;
+
+    // Converts interleaved 8-bit YCbCr pixels to RGB, with one lookup per
+    // pixel. The table must be open.
+    void convert(const cmsUInt8Number *input, cmsUInt8Number *output, size_t pixels) const;
+
+private:
+    // The whole file, and the table within.
+    void *mapping = nullptr;
+    size_t size = 0;
+    const cmsUInt8Number *table = nullptr;
+    DirectLutMethod tableMethod = DirectLutMethod::Exact;
+};
+} // namespace ycbcr
@@ -0,0 +1,197 @@
+// SPDX-FileCopyrightText: 2022 Amyspark <amy@amyspark.me>
+// SPDX-License-Identifier: BSD-3-Clause
+
+#include <lcms2.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "ycbcr_direct.h"
+#include "ycbcr_profile.h"
+
+using namespace ycbcr;
+
+namespace
+{
+using clock = std::chrono::steady_clock;
+
+// Frame size of the throughput comparison.
+constexpr size_t benchmarkPixels = 1920 * 1080;
+
+struct Options {
+    std::string profile;
+    Display destination = Display::SRGB;
+    DirectLutMethod method = DirectLutMethod::Exact;
+    std::string outputDir{"."};
+    unsigned int jobs = std::max(1U, std::thread::hardware_concurrency());
+};
+
+void log(cmsContext ctx, unsigned int errorCode, const char *msg)
+{
+    std::cerr << "context " << ctx << " error: " << errorCode << " (" << msg << ")" << std::endl;
+}
+
+void usage(const char *argv0)
+{
+    std::cerr << "Usage: " << argv0 << " [options] --profile PROFILE\n"
+              << "\n"
+              << "Tabulates the 8-bit transform from PROFILE, a YCbCr profile, to an RGB\n"
+              << "display for every one of the 2^24 inputs, and writes the table to\n"
+              << "<YCbCr MD5>_<RGB MD5>.ycclut. The table is then mapped back and its\n"
+              << "throughput compared with cmsDoTransform's.\n"
+              << "\n"
+              << "  --profile FILE      profile of the input\n"
+              << "  --destination NAME  one of srgb, p3 or bt709 (default: srgb)\n"
+              << "  --method METHOD     exact (a floating point transform through DToB0,\n"
+              << "                      rounded, v4 profiles only) or transform (the\n"
+              << "                      default 8-bit transform) (default: exact)\n"
+              << "  --output-dir DIR    where to write the table (default: .)\n"
+              << "  --jobs N            number of threads building the table\n"
+              << "                      (default: all cores)\n";
+}
+
+bool parseDestination(const std::string &name, Display &destination)
+{
+    for (const auto display : {Display::SRGB, Display::DisplayP3, Display::BT709}) {
+        if (name == displayFileName(display)) {
+            destination = display;
+            return true;
+        }
+    }
+    std::cerr << "Unknown destination: " << name << std::endl;
+    return false;
+}
+
+bool parseMethod(const std::string &name, DirectLutMethod &method)
+{
+    if (name == "exact") {
+        method = DirectLutMethod::Exact;
+    } else if (name == "transform") {
+        method = DirectLutMethod::Transform;
+    } else {
+        std::cerr << "Unknown method: " << name << std::endl;
+        return false;
+    }
+    return true;
+}
+
+double elapsedSeconds(clock::time_point start)
+{
+    return std::chrono::duration<double>(clock::now() - start).count();
+}
+
+// Megapixels per second of convert over the frame, repeated for at least
+// half a second.
+template<typename F>
+double throughput(const std::vector<cmsUInt8Number> &input, std::vector<cmsUInt8Number> &output, F convert)
+{
+    size_t pixels = 0;
+    const auto start = clock::now();
+    do {
+        convert(input.data(), output.data(), benchmarkPixels);
+        pixels += benchmarkPixels;
+    } while (elapsedSeconds(start) < 0.5);
+    return static_cast<double>(pixels) / elapsedSeconds(start) / 1e6;
+}
+} // namespace
+
+int main(int argc, char **argv)
+{
+    Options options;
+
+    for (int i = 1; i < argc; i++) {
+        const std::string arg{argv[i]};
+        if (arg == "--help" || arg == "-h") {
+            usage(argv[0]);
+            return 0;
+        }
+        if (i + 1 >= argc) {
+            usage(argv[0]);
+            return 1;
+        }
+        const std::string value{argv[++i]};
+        bool ok = true;
+        if (arg == "--profile") {
+            options.profile = value;
+        } else if (arg == "--destination") {
+            ok = parseDestination(value, options.destination);
+        } else if (arg == "--method") {
+            ok = parseMethod(value, options.method);
+        } else if (arg == "--output-dir") {
+            options.outputDir = value;
+        } else if (arg == "--jobs") {
+            options.jobs = static_cast<unsigned int>(std::max(1, std::atoi(value.c_str())));
+        } else {
+            usage(argv[0]);
+            return 1;
+        }
+        if (!ok) {
+            return 1;
+        }
+    }
+
+    if (options.profile.empty()) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    auto ctx = cmsCreateContext(nullptr, nullptr);
+    cmsSetLogErrorHandlerTHR(ctx, log);
+    auto yCbCr = cmsOpenProfileFromFileTHR(ctx, options.profile.c_str(), "r");
+    auto rgb = createDisplayProfile(ctx, options.destination);
+    if (!yCbCr || !rgb) {
+        std::cerr << "Cannot open " << (yCbCr ? displayFileName(options.destination) : options.profile.c_str()) << std::endl;
+        if (yCbCr) {
+            cmsCloseProfile(yCbCr);
+        }
+        if (rgb) {
+            cmsCloseProfile(rgb);
+        }
+        cmsDeleteContext(ctx);
+        return 1;
+    }
+
+    int result = 1;
+    const auto path = options.outputDir + "/" + directLutName(yCbCr, rgb);
+    auto start = clock::now();
+    const auto table = buildDirectLut(ctx, yCbCr, rgb, options.method, options.jobs);
+    if (!table.empty()) {
+        std::cerr << "Built in " << std::fixed << std::setprecision(2) << elapsedSeconds(start) << " s" << std::endl;
+    }
+
+    DirectLut lut;
+    if (!table.empty() && writeDirectLut(path, yCbCr, rgb, options.method, table) && lut.open(path, yCbCr, rgb)) {
+        std::cout << path << std::endl;
+
+        auto transform = cmsCreateTransformTHR(ctx, yCbCr, TYPE_YCbCr_8, rgb, TYPE_RGB_8, INTENT_PERCEPTUAL, 0);
+        if (transform) {
+            std::vector<cmsUInt8Number> input(benchmarkPixels * 3);
+            std::vector<cmsUInt8Number> output(input.size());
+            std::mt19937 random(0);
+            std::generate(input.begin(), input.end(), [&]() {
+                return static_cast<cmsUInt8Number>(random());
+            });
+            const auto direct = throughput(input, output, [&](const cmsUInt8Number *in, cmsUInt8Number *out, size_t pixels) {
+                lut.convert(in, out, pixels);
+            });
+            const auto lcms = throughput(input, output, [&](const cmsUInt8Number *in, cmsUInt8Number *out, size_t pixels) {
+                cmsDoTransform(transform, in, out, static_cast<cmsUInt32Number>(pixels));
+            });
+            std::cerr << "Direct LUT: " << direct << " Mpix/s, cmsDoTransform: " << lcms << " Mpix/s" << std::endl;
+            cmsDeleteTransform(transform);
+            result = 0;
+        }
+    }
+
+    cmsCloseProfile(rgb);
+    cmsCloseProfile(yCbCr);
+    cmsDeleteContext(ctx);
+    return result;
+}
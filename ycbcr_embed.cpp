@@ -0,0 +1,122 @@
+// SPDX-FileCopyrightText: 2022 Amyspark <amy@amyspark.me>
+// SPDX-License-Identifier: BSD-3-Clause
+
+#include "ycbcr_embed.h"
+
+#include <cctype>
+#include <fstream>
+#include <iostream>
+
+#include "version.h"
+
+namespace ycbcr
+{
+namespace
+{
+// Bytes per line of the array initializers.
+constexpr size_t bytesPerLine = 24;
+
+// bt709-6_ycbcr_v4.icc -> bt709_6_ycbcr_v4
+std::string identifier(const std::string &fileName)
+{
+    auto name = fileName.substr(0, fileName.rfind(".icc"));
+    for (auto &c : name) {
+        if (!std::isalnum(static_cast<unsigned char>(c))) {
+            c = '_';
+        }
+    }
+    return name;
+}
+
+std::string baseName(const std::string &path)
+{
+    const auto slash = path.find_last_of("/\\");
+    return slash == std::string::npos ? path : path.substr(slash + 1);
+}
+
+void writeHeader(std::ostream &out, const std::vector<NamedProfile> &profiles)
+{
+    out << "// Generated by ycbcr_generator " << COMMIT << ", do not edit.\n"
+        << "// The profiles are licensed under the Creative Commons Attribution-ShareAlike\n"
+        << "// 4.0 International License, see LICENSE-PROFILES.txt.\n"
+        << "\n"
+        << "#pragma once\n"
+        << "\n"
+        << "#include <cstddef>\n"
+        << "\n"
+        << "namespace ycbcr\n"
+        << "{\n"
+        << "struct EmbeddedProfile {\n"
+        << "    // File name, e.g. bt709-6_ycbcr_v4.icc.\n"
+        << "    const char *name;\n"
+        << "    const unsigned char *data;\n"
+        << "    std::size_t size;\n"
+        << "};\n";
+
+    for (const auto &profile : profiles) {
+        const auto &bytes = profile.second;
+        out << "\n// " << profile.first << "\n"
+            << "alignas(16) inline constexpr unsigned char " << identifier(profile.first) << "[" << bytes.size() << "] = {";
+        for (size_t i = 0; i < bytes.size(); i++) {
+            out << (i % bytesPerLine == 0 ? "\n    " : " ") << static_cast<unsigned int>(bytes[i]) << ",";
+        }
+        out << "\n};\n";
+    }
+
+    out << "\ninline constexpr EmbeddedProfile embeddedProfiles[] = {\n";
+    for (const auto &profile : profiles) {
+        const auto name = identifier(profile.first);
+        out << "    {\"" << profile.first << "\", " << name << ", sizeof(" << name << ")},\n";
+    }
+    out << "};\n"
+        << "\n"
+        << "// The profile with the given file name, or nullptr if there's none.\n"
+        << "const EmbeddedProfile *findEmbeddedProfile(const char *name);\n"
+        << "} // namespace ycbcr\n";
+}
+
+void writeSource(std::ostream &out, const std::string &header)
+{
+    out << "// Generated by ycbcr_generator " << COMMIT << ", do not edit.\n"
+        << "\n"
+        << "#include \"" << header << "\"\n"
+        << "\n"
+        << "#include <cstring>\n"
+        << "\n"
+        << "namespace ycbcr\n"
+        << "{\n"
+        << "const EmbeddedProfile *findEmbeddedProfile(const char *name)\n"
+        << "{\n"
+        << "    for (const auto &profile : embeddedProfiles) {\n"
+        << "        if (std::strcmp(profile.name, name) == 0) {\n"
+        << "            return &profile;\n"
+        << "        }\n"
+        << "    }\n"
+        << "    return nullptr;\n"
+        << "}\n"
+        << "} // namespace ycbcr\n";
+}
+} // namespace
+
+bool writeEmbeddedProfiles(const std::string &prefix, const std::vector<NamedProfile> &profiles)
+{
+    const auto headerPath = prefix + ".h";
+    const auto sourcePath = prefix + ".cpp";
+
+    std::ofstream header(headerPath);
+    writeHeader(header, profiles);
+    if (!header) {
+        std::cerr << "CANNOT WRITE " << headerPath << std::endl;
+        return false;
+    }
+
+    std::ofstream source(sourcePath);
+    writeSource(source, baseName(headerPath));
+    if (!source) {
+        std::cerr << "CANNOT WRITE " << sourcePath << std::endl;
+        return false;
+    }
+
+    return true;
+}
+} // namespace ycbcr
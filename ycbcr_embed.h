@@ -0,0 +1,22 @@
+// SPDX-FileCopyrightText: 2022 Amyspark <amy@amyspark.me>
+// SPDX-License-Identifier: BSD-3-Clause
+
+#pragma once
+
+#include <lcms2.h>
+
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace ycbcr
+{
+// A serialized profile, with its file name.
+using NamedProfile = std::pair<std::string, std::vector<cmsUInt8Number>>;
+
+// Writes prefix.h, which declares each profile as an aligned constexpr byte
+// array, plus a table of all of them, and prefix.cpp, which looks them up
+// by file name. Together they let applications open the profiles with
+// cmsOpenProfileFromMem, without any I/O.
+bool writeEmbeddedProfiles(const std::string &prefix, const std::vector<NamedProfile> &profiles);
+} // namespace ycbcr
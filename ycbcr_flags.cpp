@@ -0,0 +1,137 @@
+// SPDX-FileCopyrightText: 2022 Amyspark <amy@amyspark.me>
+// SPDX-License-Identifier: BSD-3-Clause
+
+#include "ycbcr_flags.h"
+
+#include <algorithm>
+#include <array>
+#include <iostream>
+#include <sstream>
+
+namespace ycbcr
+{
+namespace
+{
+struct FlagName {
+    cmsUInt32Number flag;
+    const char *name;
+};
+
+constexpr std::array<FlagName, 4> flagNames = {{
+    {cmsFLAGS_NOCACHE, "NOCACHE"},
+    {cmsFLAGS_NOOPTIMIZE, "NOOPTIMIZE"},
+    {cmsFLAGS_HIGHRESPRECALC, "HIGHRESPRECALC"},
+    {cmsFLAGS_LOWRESPRECALC, "LOWRESPRECALC"},
+}};
+
+constexpr const char *header = "profile\tdestination\tdirection\tformat\tflags";
+} // namespace
+
+std::vector<cmsUInt32Number> flagCombinations()
+{
+    std::vector<cmsUInt32Number> combinations;
+    for (const cmsUInt32Number cache : {0U, static_cast<cmsUInt32Number>(cmsFLAGS_NOCACHE)}) {
+        for (const cmsUInt32Number precalc : {0U,
+                                              static_cast<cmsUInt32Number>(cmsFLAGS_HIGHRESPRECALC),
+                                              static_cast<cmsUInt32Number>(cmsFLAGS_LOWRESPRECALC),
+                                              static_cast<cmsUInt32Number>(cmsFLAGS_NOOPTIMIZE)}) {
+            combinations.push_back(cache | precalc);
+        }
+    }
+    return combinations;
+}
+
+std::string flagsName(cmsUInt32Number flags)
+{
+    std::string name;
+    for (const auto &f : flagNames) {
+        if (flags & f.flag) {
+            name += (name.empty() ? "" : "|") + std::string{f.name};
+            flags &= ~f.flag;
+        }
+    }
+    if (flags) {
+        std::stringstream hex;
+        hex << "0x" << std::hex << flags;
+        name += (name.empty() ? "" : "|") + hex.str();
+    }
+    return name.empty() ? "0" : name;
+}
+
+bool parseFlags(const std::string &name, cmsUInt32Number &flags)
+{
+    flags = 0;
+    std::stringstream stream(name);
+    std::string item;
+    while (std::getline(stream, item, '|')) {
+        const auto it = std::find_if(flagNames.begin(), flagNames.end(), [&](const FlagName &f) {
+            return item == f.name;
+        });
+        if (it != flagNames.end()) {
+            flags |= it->flag;
+            continue;
+        }
+        try {
+            size_t end = 0;
+            flags |= static_cast<cmsUInt32Number>(std::stoul(item, &end, 0));
+            if (end != item.size()) {
+                return false;
+            }
+        } catch (const std::exception &) {
+            return false;
+        }
+    }
+    return true;
+}
+
+const char *formatName(cmsUInt32Number format)
+{
+    if (T_FLOAT(format)) {
+        return "FLT";
+    }
+    return T_BYTES(format) == 1 ? "8" : "16";
+}
+
+bool readFlagsTable(std::istream &in, FlagsTable &table)
+{
+    std::string line;
+    while (std::getline(in, line)) {
+        if (line.empty() || line == header) {
+            continue;
+        }
+        std::stringstream fields(line);
+        FlagsRecommendation entry{};
+        std::string flags;
+        if (!(fields >> entry.profile >> entry.destination >> entry.direction >> entry.format >> flags) || !parseFlags(flags, entry.flags)) {
+            std::cerr << "Invalid flags table line: " << line << std::endl;
+            return false;
+        }
+        table.push_back(entry);
+    }
+    return true;
+}
+
+void writeFlagsTable(std::ostream &out, const FlagsTable &table)
+{
+    out << header << '\n';
+    for (const auto &entry : table) {
+        out << entry.profile << '\t' << entry.destination << '\t' << entry.direction << '\t' << entry.format << '\t' << flagsName(entry.flags) << '\n';
+    }
+    out << std::flush;
+}
+
+cmsUInt32Number recommendedFlags(const FlagsTable &table,
+                                 const std::string &profile,
+                                 const std::string &destination,
+                                 cmsUInt32Number inputFormat,
+                                 cmsUInt32Number outputFormat,
+                                 cmsUInt32Number fallback)
+{
+    const std::string direction = T_COLORSPACE(inputFormat) == PT_YCbCr ? "ycbcr_to_rgb" : "rgb_to_ycbcr";
+    const std::string format = formatName(T_COLORSPACE(inputFormat) == PT_YCbCr ? inputFormat : outputFormat);
+    const auto it = std::find_if(table.begin(), table.end(), [&](const FlagsRecommendation &entry) {
+        return entry.profile == profile && entry.destination == destination && entry.direction == direction && entry.format == format;
+    });
+    return it == table.end() ? fallback : it->flags;
+}
+} // namespace ycbcr
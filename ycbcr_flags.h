@@ -0,0 +1,62 @@
+// SPDX-FileCopyrightText: 2022 Amyspark <amy@amyspark.me>
+// SPDX-License-Identifier: BSD-3-Clause
+
+#pragma once
+
+#include <lcms2.h>
+
+#include <istream>
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace ycbcr
+{
+// The dwFlags to create a transform with, as measured by
+// `ycbcr_benchmark --flags` for a profile, a destination and a pixel format.
+struct FlagsRecommendation {
+    // File name of the YCbCr profile, e.g. bt709-6_ycbcr_v4.icc.
+    std::string profile;
+    // The RGB side: srgb, p3 or bt709.
+    std::string destination;
+    // ycbcr_to_rgb or rgb_to_ycbcr.
+    std::string direction;
+    // 8, 16 or FLT, as given by formatName.
+    std::string format;
+    cmsUInt32Number flags = 0;
+};
+
+using FlagsTable = std::vector<FlagsRecommendation>;
+
+// The flags ycbcr_benchmark --flags tries, i.e. every combination of
+// cmsFLAGS_NOCACHE with either nothing, cmsFLAGS_HIGHRESPRECALC,
+// cmsFLAGS_LOWRESPRECALC or cmsFLAGS_NOOPTIMIZE.
+std::vector<cmsUInt32Number> flagCombinations();
+
+// dwFlags as a | separated list of names without the cmsFLAGS_ prefix, e.g.
+// NOCACHE|HIGHRESPRECALC, or 0. Unknown bits are written in hexadecimal.
+std::string flagsName(cmsUInt32Number flags);
+
+// The inverse of flagsName. Returns false if a name is unknown.
+bool parseFlags(const std::string &name, cmsUInt32Number &flags);
+
+// 8, 16 or FLT, for the sample size of an lcms pixel format.
+const char *formatName(cmsUInt32Number format);
+
+// Reads a table written by writeFlagsTable, adding it to table. Returns
+// false if the input is malformed.
+bool readFlagsTable(std::istream &in, FlagsTable &table);
+
+// Writes the table as tab separated values, with a header line.
+void writeFlagsTable(std::ostream &out, const FlagsTable &table);
+
+// The flags recommended for a transform between the YCbCr profile and the
+// destination, in the direction and format given by the lcms pixel formats
+// (one of which must be YCbCr), or fallback if the table has none.
+cmsUInt32Number recommendedFlags(const FlagsTable &table,
+                                 const std::string &profile,
+                                 const std::string &destination,
+                                 cmsUInt32Number inputFormat,
+                                 cmsUInt32Number outputFormat,
+                                 cmsUInt32Number fallback = 0);
+} // namespace ycbcr
@@ -0,0 +1,249 @@
+// SPDX-FileCopyrightText: 2022 Amyspark <amy@amyspark.me>
+// SPDX-License-Identifier: BSD-3-Clause
+
+#include "ycbcr_formatters.h"
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <iostream>
+
+namespace ycbcr
+{
+namespace
+{
+struct Layout {
+    cmsUInt32Number type;
+    // Cb and Cr share a plane, alternating.
+    bool interleaved;
+    bool halfWidth;
+    bool halfHeight;
+};
+
+constexpr std::array<Layout, 8> layouts = {{
+    {typeI420, false, true, true},
+    {typeNV12, true, true, true},
+    {typeP010, true, true, true},
+    {typeI422, false, true, false},
+    {typeI444, false, false, false},
+    {typeI010, false, true, true},
+    {typeI210, false, true, false},
+    {typeI410, false, false, false},
+}};
+
+const Layout *findLayout(cmsUInt32Number type)
+{
+    const auto it = std::find_if(layouts.begin(), layouts.end(), [type](const Layout &l) {
+        return l.type == type;
+    });
+    return it == layouts.end() ? nullptr : &*it;
+}
+
+// Where the formatters find the chroma of the row being transformed by the
+// current thread.
+struct RowState {
+    const cmsUInt8Number *luma;
+    // The chroma rows above and below the luma row, the nearest one weighted
+    // 3:1 (the same row twice without vertical subsampling). For the
+    // interleaved layouts, cr is cb plus one sample.
+    const cmsUInt8Number *cbNear;
+    const cmsUInt8Number *cbFar;
+    const cmsUInt8Number *crNear;
+    const cmsUInt8Number *crFar;
+    size_t chromaWidth;
+};
+
+thread_local const RowState *currentRow = nullptr;
+
+// A sample of Bits bits, stored in T starting at bit Shift.
+template<typename T, unsigned int Bits, unsigned int Shift>
+cmsUInt32Number sample(const cmsUInt8Number *row, size_t i)
+{
+    return (reinterpret_cast<const T *>(row)[i] >> Shift) & ((1U << Bits) - 1);
+}
+
+// Bilinear reconstruction at luma column x, from chroma samples step
+// samples apart. Returns 8 times the interpolated sample.
+template<typename T, unsigned int Bits, unsigned int Shift, bool HalfWidth>
+cmsUInt32Number chroma(const cmsUInt8Number *nearRow, const cmsUInt8Number *farRow, size_t x, size_t chromaWidth, size_t step)
+{
+    // Even columns sit on a chroma sample, odd ones halfway to the next.
+    const auto left = HalfWidth ? x / 2 : x;
+    const auto right = HalfWidth && x % 2 ? std::min(left + 1, chromaWidth - 1) : left;
+    const auto nearSum = sample<T, Bits, Shift>(nearRow, left * step) + sample<T, Bits, Shift>(nearRow, right * step);
+    const auto farSum = sample<T, Bits, Shift>(farRow, left * step) + sample<T, Bits, Shift>(farRow, right * step);
+    return 3 * nearSum + farSum;
+}
+
+template<unsigned int Bits>
+cmsUInt16Number to16(cmsUInt32Number v, cmsUInt32Number scale)
+{
+    constexpr cmsUInt32Number maximum = (1U << Bits) - 1;
+    return static_cast<cmsUInt16Number>((v * 0xFFFFU + scale * maximum / 2) / (scale * maximum));
+}
+
+template<unsigned int Bits>
+cmsFloat32Number toFloat(cmsUInt32Number v, cmsUInt32Number scale)
+{
+    constexpr cmsUInt32Number maximum = (1U << Bits) - 1;
+    return static_cast<cmsFloat32Number>(v) / static_cast<cmsFloat32Number>(scale * maximum);
+}
+
+// Reads the pixel at buffer, in the luma plane, as 8 times its Y, Cb and
+// Cr samples.
+template<typename T, unsigned int Bits, unsigned int Shift, size_t ChromaStep, bool HalfWidth>
+std::array<cmsUInt32Number, 3> unpack(const cmsUInt8Number *buffer)
+{
+    std::array<cmsUInt32Number, 3> values{8 * sample<T, Bits, Shift>(buffer, 0), 4U << Bits, 4U << Bits};
+    if (const auto *row = currentRow) {
+        const auto x = static_cast<size_t>(buffer - row->luma) / sizeof(T);
+        values[1] = chroma<T, Bits, Shift, HalfWidth>(row->cbNear, row->cbFar, x, row->chromaWidth, ChromaStep);
+        values[2] = chroma<T, Bits, Shift, HalfWidth>(row->crNear, row->crFar, x, row->chromaWidth, ChromaStep);
+    }
+    return values;
+}
+
+template<typename T, unsigned int Bits, unsigned int Shift, size_t ChromaStep, bool HalfWidth>
+cmsUInt8Number *unpack16(_cmsTRANSFORM *, cmsUInt16Number values[], cmsUInt8Number *buffer, cmsUInt32Number)
+{
+    const auto v = unpack<T, Bits, Shift, ChromaStep, HalfWidth>(buffer);
+    for (size_t i = 0; i < v.size(); i++) {
+        values[i] = to16<Bits>(v[i], 8);
+    }
+    return buffer + sizeof(T);
+}
+
+template<typename T, unsigned int Bits, unsigned int Shift, size_t ChromaStep, bool HalfWidth>
+cmsUInt8Number *unpackFloat(_cmsTRANSFORM *, cmsFloat32Number values[], cmsUInt8Number *buffer, cmsUInt32Number)
+{
+    const auto v = unpack<T, Bits, Shift, ChromaStep, HalfWidth>(buffer);
+    for (size_t i = 0; i < v.size(); i++) {
+        values[i] = toFloat<Bits>(v[i], 8);
+    }
+    return buffer + sizeof(T);
+}
+
+// Writes a 4:4:4 planar pixel, the planes stride bytes apart.
+template<typename T, unsigned int Bits>
+cmsUInt8Number *packPlanar16(_cmsTRANSFORM *, cmsUInt16Number values[], cmsUInt8Number *buffer, cmsUInt32Number stride)
+{
+    constexpr cmsUInt32Number maximum = (1U << Bits) - 1;
+    for (size_t i = 0; i < 3; i++) {
+        *reinterpret_cast<T *>(buffer + i * stride) = static_cast<T>((values[i] * maximum + 0x7FFFU) / 0xFFFFU);
+    }
+    return buffer + sizeof(T);
+}
+
+template<typename T, unsigned int Bits, unsigned int Shift, size_t ChromaStep, bool HalfWidth>
+cmsFormatter inputFormatter(cmsUInt32Number flags)
+{
+    cmsFormatter formatter{};
+    if (flags & CMS_PACK_FLAGS_FLOAT) {
+        formatter.FmtFloat = unpackFloat<T, Bits, Shift, ChromaStep, HalfWidth>;
+    } else {
+        formatter.Fmt16 = unpack16<T, Bits, Shift, ChromaStep, HalfWidth>;
+    }
+    return formatter;
+}
+
+cmsFormatter formattersFactory(cmsUInt32Number type, cmsFormatterDirection dir, cmsUInt32Number flags)
+{
+    cmsFormatter formatter{};
+    formatter.Fmt16 = nullptr;
+    if (dir == cmsFormatterOutput) {
+        if (flags & CMS_PACK_FLAGS_FLOAT) {
+            return formatter;
+        }
+        if (type == typeI444) {
+            formatter.Fmt16 = packPlanar16<uint8_t, 8>;
+        } else if (type == typeI410) {
+            formatter.Fmt16 = packPlanar16<uint16_t, 10>;
+        }
+        return formatter;
+    }
+    switch (type) {
+    case typeI420:
+    case typeI422:
+        return inputFormatter<uint8_t, 8, 0, 1, true>(flags);
+    case typeI444:
+        return inputFormatter<uint8_t, 8, 0, 1, false>(flags);
+    case typeNV12:
+        return inputFormatter<uint8_t, 8, 0, 2, true>(flags);
+    case typeP010:
+        return inputFormatter<uint16_t, 10, 6, 2, true>(flags);
+    case typeI010:
+    case typeI210:
+        return inputFormatter<uint16_t, 10, 0, 1, true>(flags);
+    case typeI410:
+        return inputFormatter<uint16_t, 10, 0, 1, false>(flags);
+    default:
+        return formatter;
+    }
+}
+
+cmsPluginFormatters plugin = {{cmsPluginMagicNumber, 2000, cmsPluginFormattersSig, nullptr}, formattersFactory};
+} // namespace
+
+cmsPluginBase *formattersPlugin()
+{
+    return &plugin.base;
+}
+
+bool registerFormatters(cmsContext ctx)
+{
+    return cmsPluginTHR(ctx, formattersPlugin()) != FALSE;
+}
+
+bool transformRows(cmsHTRANSFORM transform, const Frame &frame, void *out, size_t bytesPerLine, cmsUInt32Number firstRow, cmsUInt32Number rowCount)
+{
+    const auto *layout = findLayout(frame.type);
+    if (!layout || cmsGetTransformInputFormat(transform) != frame.type) {
+        std::cerr << "Transform input format " << cmsGetTransformInputFormat(transform) << " doesn't match the frame's " << frame.type << std::endl;
+        return false;
+    }
+    if (!frame.luma || !frame.cb || (!layout->interleaved && !frame.cr) || !out) {
+        std::cerr << "Frame lacks a plane" << std::endl;
+        return false;
+    }
+    if (firstRow > frame.height || rowCount > frame.height - firstRow) {
+        std::cerr << "Rows " << firstRow << " + " << rowCount << " out of the frame's " << frame.height << std::endl;
+        return false;
+    }
+
+    const size_t sampleSize = T_BYTES(frame.type);
+    const size_t chromaHeight = layout->halfHeight ? (frame.height + 1) / 2 : frame.height;
+    const auto *luma = static_cast<const cmsUInt8Number *>(frame.luma);
+    const auto *cb = static_cast<const cmsUInt8Number *>(frame.cb);
+    const auto *cr = layout->interleaved ? cb + sampleSize : static_cast<const cmsUInt8Number *>(frame.cr);
+    const auto crStride = layout->interleaved ? frame.cbStride : frame.crStride;
+    const auto bytesPerPlane = static_cast<cmsUInt32Number>(frame.height * bytesPerLine);
+    auto *output = static_cast<cmsUInt8Number *>(out);
+
+    RowState row{};
+    row.chromaWidth = layout->halfWidth ? (frame.width + 1) / 2 : frame.width;
+    currentRow = &row;
+    for (size_t y = firstRow; y < size_t{firstRow} + rowCount; y++) {
+        // Chroma row c sits between luma rows 2c and 2c + 1.
+        auto nearRow = y;
+        auto farRow = y;
+        if (layout->halfHeight) {
+            nearRow = y / 2;
+            farRow = y % 2 ? std::min(nearRow + 1, chromaHeight - 1) : (nearRow > 0 ? nearRow - 1 : 0);
+        }
+        row.luma = luma + y * frame.lumaStride;
+        row.cbNear = cb + nearRow * frame.cbStride;
+        row.cbFar = cb + farRow * frame.cbStride;
+        row.crNear = cr + nearRow * crStride;
+        row.crFar = cr + farRow * crStride;
+        cmsDoTransformLineStride(transform, row.luma, output + y * bytesPerLine, frame.width, 1, 0, static_cast<cmsUInt32Number>(bytesPerLine), 0, bytesPerPlane);
+    }
+    currentRow = nullptr;
+
+    return true;
+}
+
+bool transformFrame(cmsHTRANSFORM transform, const Frame &frame, void *out, size_t bytesPerLine)
+{
+    return transformRows(transform, frame, out, bytesPerLine, 0, frame.height);
+}
+} // namespace ycbcr
@@ -0,0 +1,78 @@
+// SPDX-FileCopyrightText: 2022 Amyspark <amy@amyspark.me>
+// SPDX-License-Identifier: BSD-3-Clause
+
+#pragma once
+
+#include <lcms2.h>
+#include <lcms2_plugin.h>
+
+#include <cstddef>
+
+namespace ycbcr
+{
+// Planar and chroma subsampled YCbCr layouts, as lcms pixel types. The
+// layout lives in the top byte of the type, which lcms leaves unused.
+//
+// I420, I422, I444: 8-bit Y, Cb and Cr planes, with the chroma halved in
+//                   both directions, horizontally, or not at all.
+// I010, I210, I410: same, in 16-bit words holding 10 bits, LSB aligned
+//                   (as in Y4M).
+// NV12: 8-bit Y plane and interleaved CbCr plane, with the chroma halved in
+//       both directions.
+// P010: same as NV12, in 16-bit words holding 10 bits, MSB aligned.
+//
+// I444 and I410 can be written as well.
+constexpr cmsUInt32Number layoutShift = 24;
+constexpr cmsUInt32Number typeI420 = (1U << layoutShift) | COLORSPACE_SH(PT_YCbCr) | CHANNELS_SH(3) | BYTES_SH(1) | PLANAR_SH(1);
+constexpr cmsUInt32Number typeNV12 = (2U << layoutShift) | COLORSPACE_SH(PT_YCbCr) | CHANNELS_SH(3) | BYTES_SH(1) | PLANAR_SH(1);
+constexpr cmsUInt32Number typeP010 = (3U << layoutShift) | COLORSPACE_SH(PT_YCbCr) | CHANNELS_SH(3) | BYTES_SH(2) | PLANAR_SH(1);
+constexpr cmsUInt32Number typeI422 = (4U << layoutShift) | COLORSPACE_SH(PT_YCbCr) | CHANNELS_SH(3) | BYTES_SH(1) | PLANAR_SH(1);
+constexpr cmsUInt32Number typeI444 = (5U << layoutShift) | COLORSPACE_SH(PT_YCbCr) | CHANNELS_SH(3) | BYTES_SH(1) | PLANAR_SH(1);
+constexpr cmsUInt32Number typeI010 = (6U << layoutShift) | COLORSPACE_SH(PT_YCbCr) | CHANNELS_SH(3) | BYTES_SH(2) | PLANAR_SH(1);
+constexpr cmsUInt32Number typeI210 = (7U << layoutShift) | COLORSPACE_SH(PT_YCbCr) | CHANNELS_SH(3) | BYTES_SH(2) | PLANAR_SH(1);
+constexpr cmsUInt32Number typeI410 = (8U << layoutShift) | COLORSPACE_SH(PT_YCbCr) | CHANNELS_SH(3) | BYTES_SH(2) | PLANAR_SH(1);
+
+// A frame in one of the layouts above. Strides are in bytes. For NV12 and
+// P010, cb points to the interleaved CbCr plane and cr is unused.
+struct Frame {
+    cmsUInt32Number type;
+    cmsUInt32Number width;
+    cmsUInt32Number height;
+    const void *luma;
+    size_t lumaStride;
+    const void *cb;
+    size_t cbStride;
+    const void *cr;
+    size_t crStride;
+};
+
+// A formatters plugin that reads the layouts above directly from their
+// planes, without repacking them into interleaved 4:4:4 first, into either
+// 16-bit or floating point transforms.
+//
+// Chroma is reconstructed bilinearly, with the MPEG-2 / H.264 siting: each
+// chroma sample is aligned with the even luma columns, and, for 4:2:0,
+// halfway between two luma rows. The samples are scaled to 16 bits before
+// interpolation, so the reconstruction doesn't round to 8 or 10 bits.
+//
+// The layouts can only be read one row at a time, through transformRows()
+// or transformFrame(), which tell the formatters where the chroma rows are.
+// Called through any other entry point, the formatters see neutral chroma.
+cmsPluginBase *formattersPlugin();
+
+// Registers the plugin in ctx. Returns false on failure.
+bool registerFormatters(cmsContext ctx);
+
+// Transforms rows firstRow to firstRow + rowCount - 1 of frame into out,
+// where each output row takes bytesPerLine bytes. For planar output formats,
+// the planes are frame.height * bytesPerLine bytes apart. transform must have
+// been created, in a context with the plugin registered, with frame.type as
+// its input format. Returns false if the frame or rows are malformed.
+//
+// Different rows of the same frame can be transformed from different
+// threads, if the transform was created with cmsFLAGS_NOCACHE.
+bool transformRows(cmsHTRANSFORM transform, const Frame &frame, void *out, size_t bytesPerLine, cmsUInt32Number firstRow, cmsUInt32Number rowCount);
+
+// Same as above, for the whole frame.
+bool transformFrame(cmsHTRANSFORM transform, const Frame &frame, void *out, size_t bytesPerLine);
+} // namespace ycbcr
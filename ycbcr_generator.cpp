@@ -0,0 +1,720 @@
+// SPDX-FileCopyrightText: 2022 Amyspark <amy@amyspark.me>
+// SPDX-License-Identifier: BSD-3-Clause
+
+#include <lcms2.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <set>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "ycbcr_embed.h"
+#include "ycbcr_lut.h"
+#include "ycbcr_profile.h"
+#include "ycbcr_stages.h"
+#include "ycbcr_sweep.h"
+#include "ycbcr_tags.h"
+#include "ycbcr_validate.h"
+
+using namespace ycbcr;
+
+namespace
+{
+void log(cmsContext ctx, unsigned int errorCode, const char *msg)
+{
+    std::cerr << "context " << ctx << " error: " << errorCode << " (" << msg << ")" << std::endl;
+}
+
+void usage(const char *argv0)
+{
+    std::cerr << "Usage: " << argv0 << " [options]\n"
+              << "\n"
+              << "Builds every combination of the requested variants.\n"
+              << "\n"
+              << "  --standard LIST    comma separated list of bt601, bt709, bt2020 (default:\n"
+              << "                     bt601, bt709)\n"
+              << "  --curve LIST       comma separated list of oetf, bt1886, pq, hlg; pq and\n"
+              << "                     hlg only build v4 profiles with --precision float\n"
+              << "                     (default: oetf, bt1886)\n"
+              << "  --version LIST     comma separated list of 2, 4 (default: all)\n"
+              << "  --resolution LIST  comma separated list of CLUT grid points (default: " << defaultResolution << ")\n"
+              << "  --precision LIST   comma separated list of 16, float: storage of the v4\n"
+              << "                     DToB0/BToD0 pipelines (default: 16)\n"
+              << "  --range LIST       comma separated list of full, limited8, limited10:\n"
+              << "                     quantization range of the YCbCr samples (default: full)\n"
+              << "  --shaper LIST      comma separated list of none, fitted: curves around the\n"
+              << "                     CLUT of the v2 profiles (default: none)\n"
+              << "  --storage LIST     comma separated list of full, compact: compact profiles\n"
+              << "                     have a short copyright, no device descriptions, formula\n"
+              << "                     curves where possible and shared identical tags\n"
+              << "                     (default: full)\n"
+              << "  --clut-precision LIST\n"
+              << "                     comma separated list of 16, 8: sample size of the\n"
+              << "                     AToB0/BToA0 and device link CLUTs (default: 16)\n"
+              << "  --manifest FILE    read the variants from FILE instead, one per line:\n"
+              << "                     <standard> <curve> <version> [resolution [precision [range\n"
+              << "                     [shaper [storage [clut-precision]]]]]]\n"
+              << "  --link LIST        also write device links from each variant to the comma\n"
+              << "                     separated list of srgb, p3, bt709 (default: none)\n"
+              << "  --link-resolution LIST\n"
+              << "                     comma separated list of device link grid points\n"
+              << "                     (default: " << defaultLinkResolution << ")\n"
+              << "  --lut LIST         also write 3D LUTs of the YCbCr <-> R'G'B' conversion of\n"
+              << "                     each standard and range, in the comma separated list of\n"
+              << "                     cube, clf formats (default: none)\n"
+              << "  --lut-size LIST    comma separated list of 3D LUT grid points (default: " << defaultLutSize << ")\n"
+              << "  --output-dir DIR   directory where the profiles are written (default: .)\n"
+              << "  --embed PREFIX     instead of writing the profiles, write PREFIX.h and\n"
+              << "                     PREFIX.cpp, which embed them as byte arrays\n"
+              << "  --jobs N           number of worker threads (default: all cores)\n"
+              << "  --sweep            instead of writing the profiles, print their size,\n"
+              << "                     transform throughput and error against the analytic\n"
+              << "                     pipeline (default resolutions: 9,17,24,33,45,65)\n"
+              << "  --stages           instead of writing the profiles, print the time taken\n"
+              << "                     by each stage of their pipeline tags, and its error\n"
+              << "                     against the analytic pipeline\n"
+              << "  --tags             instead of writing the profiles, print the bytes taken\n"
+              << "                     by each of their tags\n"
+              << "  --validate         instead of writing the profiles, run every 10-bit code\n"
+              << "                     value through their AToB0/BToA0 and DToB0/BToD0\n"
+              << "                     round trips, and print the error against the analytic\n"
+              << "                     pipeline\n"
+              << "  --shard I/N        validate only the I-th of N parts of the code values,\n"
+              << "                     and print raw statistics for --merge\n"
+              << "  --merge LIST       print the report of the comma separated list of\n"
+              << "                     --shard outputs, and exit\n";
+}
+
+std::vector<std::string> split(const std::string &list)
+{
+    std::vector<std::string> items;
+    std::stringstream stream(list);
+    std::string item;
+    while (std::getline(stream, item, ',')) {
+        if (!item.empty()) {
+            items.push_back(item);
+        }
+    }
+    return items;
+}
+
+bool parseStandard(const std::string &value, Standard &standard)
+{
+    if (value == "bt601") {
+        standard = Standard::BT601;
+    } else if (value == "bt709") {
+        standard = Standard::BT709;
+    } else if (value == "bt2020") {
+        standard = Standard::BT2020;
+    } else {
+        std::cerr << "Unknown standard: " << value << std::endl;
+        return false;
+    }
+    return true;
+}
+
+bool parseCurve(const std::string &value, Curve &curve)
+{
+    if (value == "oetf") {
+        curve = Curve::OETF;
+    } else if (value == "bt1886") {
+        curve = Curve::BT1886;
+    } else if (value == "pq") {
+        curve = Curve::PQ;
+    } else if (value == "hlg") {
+        curve = Curve::HLG;
+    } else {
+        std::cerr << "Unknown curve: " << value << std::endl;
+        return false;
+    }
+    return true;
+}
+
+bool parseVersion(const std::string &value, int &version)
+{
+    if (value == "2" || value == "v2") {
+        version = 2;
+    } else if (value == "4" || value == "v4") {
+        version = 4;
+    } else {
+        std::cerr << "Unknown ICC version: " << value << std::endl;
+        return false;
+    }
+    return true;
+}
+
+bool parseResolution(const std::string &value, cmsUInt32Number &resolution)
+{
+    try {
+        const auto n = std::stoul(value);
+        // The CLUT stage can't hold less than 2 or more than 255 points per
+        // dimension.
+        if (n < 2 || n > 255) {
+            throw std::out_of_range(value);
+        }
+        resolution = static_cast<cmsUInt32Number>(n);
+    } catch (const std::exception &) {
+        std::cerr << "Invalid resolution: " << value << std::endl;
+        return false;
+    }
+    return true;
+}
+
+bool parsePrecision(const std::string &value, Precision &precision)
+{
+    if (value == "16") {
+        precision = Precision::UInt16;
+    } else if (value == "float") {
+        precision = Precision::Float;
+    } else {
+        std::cerr << "Unknown precision: " << value << std::endl;
+        return false;
+    }
+    return true;
+}
+
+bool parseRange(const std::string &value, Range &range)
+{
+    if (value == "full") {
+        range = Range::Full;
+    } else if (value == "limited8") {
+        range = Range::Limited8;
+    } else if (value == "limited10") {
+        range = Range::Limited10;
+    } else {
+        std::cerr << "Unknown range: " << value << std::endl;
+        return false;
+    }
+    return true;
+}
+
+bool parseShard(const std::string &value, Shard &shard)
+{
+    const auto slash = value.find('/');
+    try {
+        if (slash == std::string::npos) {
+            throw std::invalid_argument(value);
+        }
+        const auto index = std::stoul(value.substr(0, slash));
+        const auto count = std::stoul(value.substr(slash + 1));
+        if (count == 0 || index >= count || count > 1024 * 1024) {
+            throw std::out_of_range(value);
+        }
+        shard.index = static_cast<unsigned int>(index);
+        shard.count = static_cast<unsigned int>(count);
+    } catch (const std::exception &) {
+        std::cerr << "Invalid shard: " << value << std::endl;
+        return false;
+    }
+    return true;
+}
+
+bool parseShaper(const std::string &value, Shaper &shaper)
+{
+    if (value == "none") {
+        shaper = Shaper::Identity;
+    } else if (value == "fitted") {
+        shaper = Shaper::Fitted;
+    } else {
+        std::cerr << "Unknown shaper: " << value << std::endl;
+        return false;
+    }
+    return true;
+}
+
+bool parseStorage(const std::string &value, Storage &storage)
+{
+    if (value == "full") {
+        storage = Storage::Full;
+    } else if (value == "compact") {
+        storage = Storage::Compact;
+    } else {
+        std::cerr << "Unknown storage: " << value << std::endl;
+        return false;
+    }
+    return true;
+}
+
+bool parseCLutPrecision(const std::string &value, CLutPrecision &precision)
+{
+    if (value == "16") {
+        precision = CLutPrecision::UInt16;
+    } else if (value == "8") {
+        precision = CLutPrecision::UInt8;
+    } else {
+        std::cerr << "Unknown CLUT precision: " << value << std::endl;
+        return false;
+    }
+    return true;
+}
+
+bool parseDisplay(const std::string &value, Display &display)
+{
+    if (value == "srgb") {
+        display = Display::SRGB;
+    } else if (value == "p3") {
+        display = Display::DisplayP3;
+    } else if (value == "bt709") {
+        display = Display::BT709;
+    } else {
+        std::cerr << "Unknown display: " << value << std::endl;
+        return false;
+    }
+    return true;
+}
+
+bool parseLutFormat(const std::string &value, LutFormat &format)
+{
+    if (value == "cube") {
+        format = LutFormat::Cube;
+    } else if (value == "clf") {
+        format = LutFormat::CLF;
+    } else {
+        std::cerr << "Unknown LUT format: " << value << std::endl;
+        return false;
+    }
+    return true;
+}
+
+template<typename T, typename Parser>
+bool parseList(const std::string &list, std::vector<T> &values, Parser parse)
+{
+    values.clear();
+    for (const auto &item : split(list)) {
+        T value{};
+        if (!parse(item, value)) {
+            return false;
+        }
+        values.push_back(value);
+    }
+    return !values.empty();
+}
+
+int mergeShards(const std::string &list)
+{
+    std::vector<RoundTripStats> results;
+    for (const auto &path : split(list)) {
+        std::ifstream file(path);
+        if (!file) {
+            std::cerr << "Cannot open shard " << path << std::endl;
+            return 1;
+        }
+        if (!mergeValidationShard(file, results)) {
+            return 1;
+        }
+    }
+    printValidationReport(std::cout, results);
+    return 0;
+}
+
+bool readManifest(const std::string &path, std::vector<Params> &variants)
+{
+    std::ifstream file(path);
+    if (!file) {
+        std::cerr << "Cannot open manifest " << path << std::endl;
+        return false;
+    }
+
+    std::string line;
+    while (std::getline(file, line)) {
+        line = line.substr(0, line.find('#'));
+        std::stringstream fields(line);
+        std::string standard, curve, version, resolution, precision, range, shaper, storage, clutPrecision;
+        if (!(fields >> standard)) {
+            continue;
+        }
+        Params params{};
+        if (!(fields >> curve >> version) || !parseStandard(standard, params.standard) || !parseCurve(curve, params.curve)
+            || !parseVersion(version, params.version)) {
+            std::cerr << "Invalid manifest entry: " << line << std::endl;
+            return false;
+        }
+        if (fields >> resolution && !parseResolution(resolution, params.resolution)) {
+            return false;
+        }
+        if (fields >> precision && !parsePrecision(precision, params.precision)) {
+            return false;
+        }
+        if (fields >> range && !parseRange(range, params.range)) {
+            return false;
+        }
+        if (fields >> shaper && !parseShaper(shaper, params.shaper)) {
+            return false;
+        }
+        if (fields >> storage && !parseStorage(storage, params.storage)) {
+            return false;
+        }
+        if (fields >> clutPrecision && !parseCLutPrecision(clutPrecision, params.clutPrecision)) {
+            return false;
+        }
+        if (params.version == 2 && params.precision != Precision::UInt16) {
+            std::cerr << "Floating point precision requires a v4 profile: " << line << std::endl;
+            return false;
+        }
+        if (params.version == 4 && params.shaper != Shaper::Identity) {
+            std::cerr << "Shaper curves require a v2 profile: " << line << std::endl;
+            return false;
+        }
+        if (params.shaper != Shaper::Identity && params.clutPrecision == CLutPrecision::UInt8) {
+            std::cerr << "Shaper curves require 16-bit CLUTs: " << line << std::endl;
+            return false;
+        }
+        if (isHDR(params.curve) && params.precision != Precision::Float) {
+            std::cerr << "PQ and HLG require a v4 profile with floating point precision: " << line << std::endl;
+            return false;
+        }
+        variants.push_back(params);
+    }
+
+    return true;
+}
+} // namespace
+
+int main(int argc, char **argv)
+{
+    std::vector<Standard> standards{Standard::BT601, Standard::BT709};
+    std::vector<Curve> curves{Curve::OETF, Curve::BT1886};
+    std::vector<int> versions{2, 4};
+    std::vector<cmsUInt32Number> resolutions{defaultResolution};
+    std::vector<Precision> precisions{Precision::UInt16};
+    std::vector<Range> ranges{Range::Full};
+    std::vector<Shaper> shapers{Shaper::Identity};
+    std::vector<Storage> storages{Storage::Full};
+    std::vector<CLutPrecision> clutPrecisions{CLutPrecision::UInt16};
+    std::vector<Display> displays;
+    std::vector<cmsUInt32Number> linkResolutions{defaultLinkResolution};
+    std::vector<LutFormat> lutFormats;
+    std::vector<cmsUInt32Number> lutSizes{defaultLutSize};
+    std::string manifest;
+    std::string outputDir{"."};
+    std::string embed;
+    unsigned int jobs = std::max(1U, std::thread::hardware_concurrency());
+    bool sweep = false;
+    bool validate = false;
+    bool tags = false;
+    bool stages = false;
+    Shard shard{};
+    bool resolutionsGiven = false;
+
+    for (int i = 1; i < argc; i++) {
+        const std::string arg{argv[i]};
+        if (arg == "--help" || arg == "-h") {
+            usage(argv[0]);
+            return 0;
+        }
+        if (arg == "--sweep") {
+            sweep = true;
+            continue;
+        }
+        if (arg == "--validate") {
+            validate = true;
+            continue;
+        }
+        if (arg == "--tags") {
+            tags = true;
+            continue;
+        }
+        if (arg == "--stages") {
+            stages = true;
+            continue;
+        }
+        if (i + 1 >= argc) {
+            usage(argv[0]);
+            return 1;
+        }
+        const std::string value{argv[++i]};
+        bool ok = true;
+        if (arg == "--standard") {
+            ok = parseList(value, standards, parseStandard);
+        } else if (arg == "--curve") {
+            ok = parseList(value, curves, parseCurve);
+        } else if (arg == "--version") {
+            ok = parseList(value, versions, parseVersion);
+        } else if (arg == "--resolution") {
+            ok = parseList(value, resolutions, parseResolution);
+            resolutionsGiven = true;
+        } else if (arg == "--precision") {
+            ok = parseList(value, precisions, parsePrecision);
+        } else if (arg == "--range") {
+            ok = parseList(value, ranges, parseRange);
+        } else if (arg == "--shaper") {
+            ok = parseList(value, shapers, parseShaper);
+        } else if (arg == "--storage") {
+            ok = parseList(value, storages, parseStorage);
+        } else if (arg == "--clut-precision") {
+            ok = parseList(value, clutPrecisions, parseCLutPrecision);
+        } else if (arg == "--link") {
+            ok = parseList(value, displays, parseDisplay);
+        } else if (arg == "--link-resolution") {
+            ok = parseList(value, linkResolutions, parseResolution);
+        } else if (arg == "--lut") {
+            ok = parseList(value, lutFormats, parseLutFormat);
+        } else if (arg == "--lut-size") {
+            ok = parseList(value, lutSizes, parseResolution);
+        } else if (arg == "--manifest") {
+            manifest = value;
+        } else if (arg == "--output-dir") {
+            outputDir = value;
+        } else if (arg == "--embed") {
+            embed = value;
+        } else if (arg == "--shard") {
+            ok = parseShard(value, shard);
+        } else if (arg == "--merge") {
+            return mergeShards(value);
+        } else if (arg == "--jobs") {
+            jobs = std::max(1, std::atoi(value.c_str()));
+        } else {
+            usage(argv[0]);
+            return 1;
+        }
+        if (!ok) {
+            return 1;
+        }
+    }
+
+    if (sweep && !resolutionsGiven) {
+        resolutions = {9, 17, 24, 33, 45, 65};
+    }
+
+    std::vector<Params> variants;
+    if (!manifest.empty()) {
+        if (!readManifest(manifest, variants)) {
+            return 1;
+        }
+    } else {
+        for (const auto standard : standards) {
+            for (const auto curve : curves) {
+                for (const auto version : versions) {
+                    for (const auto resolution : resolutions) {
+                        for (const auto precision : precisions) {
+                            // v2 profiles have no DToB0/BToD0 tags.
+                            if (version == 2 && precision != Precision::UInt16) {
+                                continue;
+                            }
+                            // Nor room for the HDR highlights otherwise.
+                            if (isHDR(curve) && precision != Precision::Float) {
+                                continue;
+                            }
+                            for (const auto range : ranges) {
+                                for (const auto shaper : shapers) {
+                                    // v4 profiles keep the curves out of the
+                                    // CLUT already.
+                                    if (version == 4 && shaper != Shaper::Identity) {
+                                        continue;
+                                    }
+                                    for (const auto storage : storages) {
+                                        for (const auto clutPrecision : clutPrecisions) {
+                                            // Nor do the 8-bit curves of
+                                            // lut8Type have room for them.
+                                            if (shaper != Shaper::Identity && clutPrecision == CLutPrecision::UInt8) {
+                                                continue;
+                                            }
+                                            variants.push_back({standard, curve, version, resolution, precision, range, shaper, storage, clutPrecision});
+                                        }
+                                    }
+                                }
+                            }
+                        }
+                    }
+                }
+            }
+        }
+        if (variants.empty()) {
+            std::cerr << "No variant matches the options (PQ and HLG need --version 4 --precision float, --shaper fitted needs --version 2 --clut-precision 16)" << std::endl;
+            return 1;
+        }
+    }
+
+    cmsSetLogErrorHandlerTHR(nullptr, log);
+    auto ctx = cmsCreateContext(nullptr, nullptr);
+    cmsSetLogErrorHandlerTHR(ctx, log);
+    const auto shared = createSharedData(ctx);
+    cmsDeleteContext(ctx);
+
+    // Each worker owns a context (and the curves allocated within), and
+    // picks the next pending variant until there are none left. Cores left
+    // over when there are fewer variants than jobs go to CLUT sampling.
+    const auto workerCount = std::min<unsigned int>(jobs, std::max<size_t>(1, variants.size()));
+    const auto samplerThreads = std::max(1U, jobs / workerCount);
+    std::atomic<size_t> next{0};
+    std::atomic<int> result{0};
+    // In sweep mode the profiles are kept in memory, and their throughput
+    // measured once all the workers are done.
+    std::vector<SweepResult> report(sweep ? variants.size() : 0);
+    // Same when validating, embedding them or reporting their tags or
+    // stages.
+    std::vector<std::vector<cmsUInt8Number>> serialized(sweep || validate || tags || stages || !embed.empty() ? variants.size() : 0);
+    const auto worker = [&]() {
+        auto workerCtx = cmsCreateContext(nullptr, nullptr);
+        cmsSetLogErrorHandlerTHR(workerCtx, log);
+        {
+            const ProfileBuilder builder(workerCtx, shared, samplerThreads);
+            for (auto i = next++; i < variants.size(); i = next++) {
+                const auto &params = variants[i];
+                if (sweep) {
+                    report[i].params = params;
+                }
+                auto profile = builder.build(params);
+                if (!profile) {
+                    result = -1;
+                    continue;
+                }
+                if (params.storage == Storage::Compact) {
+                    // Compact only changes how the profile is stored, so it
+                    // has to give the colors of the full one.
+                    auto fullParams = params;
+                    fullParams.storage = Storage::Full;
+                    auto full = builder.build(fullParams);
+                    if (!full || !checkCompact(workerCtx, profileBytes(full), profileBytes(profile), params)) {
+                        std::cerr << "Profile " << profileName(params) << " does not match its full counterpart" << std::endl;
+                        result = -3;
+                    }
+                    if (full) {
+                        cmsCloseProfile(full);
+                    }
+                }
+                if (!sweep && (validate || tags || stages || !embed.empty())) {
+                    serialized[i] = profileBytes(profile);
+                    if (serialized[i].empty()) {
+                        std::cerr << "CANNOT SERIALIZE PROFILE " << profileName(params) << std::endl;
+                        result = -2;
+                    }
+                    cmsCloseProfile(profile);
+                    continue;
+                }
+                if (sweep) {
+                    serialized[i] = profileBytes(profile);
+                    if (serialized[i].empty() || !measureAccuracy(workerCtx, serialized[i], report[i])) {
+                        std::cerr << "Cannot measure the accuracy of " << profileName(params) << std::endl;
+                        result = -3;
+                    }
+                    cmsCloseProfile(profile);
+                    continue;
+                }
+                const auto path = outputDir + "/" + profileName(params);
+                if (!cmsSaveProfileToFile(profile, path.c_str())) {
+                    std::cerr << "CANNOT WRITE PROFILE " << path << std::endl;
+                    result = -2;
+                }
+                for (const auto display : displays) {
+                    for (const auto resolution : linkResolutions) {
+                        const LinkParams link{display, resolution};
+                        auto deviceLink = builder.buildLink(profile, params, link);
+                        if (!deviceLink) {
+                            result = -1;
+                            continue;
+                        }
+                        const auto linkPath = outputDir + "/" + linkName(params, link);
+                        if (!cmsSaveProfileToFile(deviceLink, linkPath.c_str())) {
+                            std::cerr << "CANNOT WRITE PROFILE " << linkPath << std::endl;
+                            result = -2;
+                        }
+                        cmsCloseProfile(deviceLink);
+                    }
+                }
+                cmsCloseProfile(profile);
+            }
+        }
+        cmsDeleteContext(workerCtx);
+    };
+
+    std::vector<std::thread> workers;
+    for (unsigned int i = 1; i < workerCount; i++) {
+        workers.emplace_back(worker);
+    }
+    worker();
+    for (auto &t : workers) {
+        t.join();
+    }
+
+    if (sweep) {
+        auto sweepCtx = cmsCreateContext(nullptr, nullptr);
+        cmsSetLogErrorHandlerTHR(sweepCtx, log);
+        for (size_t i = 0; i < report.size(); i++) {
+            if (!serialized[i].empty() && !measureThroughput(sweepCtx, serialized[i], report[i])) {
+                std::cerr << "Cannot measure the throughput of " << profileName(report[i].params) << std::endl;
+                result = -3;
+            }
+        }
+        cmsDeleteContext(sweepCtx);
+        printSweepReport(std::cout, report);
+    } else if (stages) {
+        // Timed one profile at a time, once all the workers are done.
+        auto stagesCtx = cmsCreateContext(nullptr, nullptr);
+        cmsSetLogErrorHandlerTHR(stagesCtx, log);
+        printStageReportHeader(std::cout);
+        for (size_t i = 0; i < variants.size(); i++) {
+            std::vector<StageReport> report;
+            if (!serialized[i].empty() && !profileStages(stagesCtx, serialized[i], variants[i], report)) {
+                std::cerr << "Cannot profile the stages of " << profileName(variants[i]) << std::endl;
+                result = -3;
+            }
+            printStageReport(std::cout, profileName(variants[i]), report);
+        }
+        cmsDeleteContext(stagesCtx);
+    } else if (tags) {
+        printTagReportHeader(std::cout);
+        for (size_t i = 0; i < variants.size(); i++) {
+            if (!serialized[i].empty() && !printTagReport(std::cout, profileName(variants[i]), serialized[i])) {
+                result = -3;
+            }
+        }
+    } else if (validate) {
+        // Each profile gets all the cores in turn.
+        auto validateCtx = cmsCreateContext(nullptr, nullptr);
+        cmsSetLogErrorHandlerTHR(validateCtx, log);
+        std::vector<RoundTripStats> stats;
+        for (size_t i = 0; i < variants.size(); i++) {
+            if (!serialized[i].empty() && !validateProfile(validateCtx, serialized[i], variants[i], shard, jobs, stats)) {
+                std::cerr << "Cannot validate " << profileName(variants[i]) << std::endl;
+                result = -3;
+            }
+        }
+        cmsDeleteContext(validateCtx);
+        if (shard.count > 1) {
+            writeValidationShard(std::cout, stats);
+        } else {
+            printValidationReport(std::cout, stats);
+        }
+    } else if (!embed.empty() && result == 0) {
+        std::vector<NamedProfile> profiles;
+        for (size_t i = 0; i < variants.size(); i++) {
+            profiles.emplace_back(profileName(variants[i]), std::move(serialized[i]));
+        }
+        if (!writeEmbeddedProfiles(embed, profiles)) {
+            result = -2;
+        }
+    }
+
+    if (!sweep && !validate && !tags && !stages && embed.empty()) {
+        // The LUTs don't depend on most of the options, so several variants
+        // can share one. Each gets all the cores in turn.
+        std::set<std::string> written;
+        for (const auto &params : variants) {
+            for (const auto format : lutFormats) {
+                for (const auto size : lutSizes) {
+                    for (const auto direction : {LutDirection::YCbCrToRGB, LutDirection::RGBToYCbCr}) {
+                        const LutParams lut{format, direction, size};
+                        const auto name = lutName(params, lut);
+                        if (!written.insert(name).second) {
+                            continue;
+                        }
+                        if (!writeLut(outputDir + "/" + name, params, lut, jobs)) {
+                            result = -2;
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    return result;
+}
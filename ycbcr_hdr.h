@@ -0,0 +1,70 @@
+// SPDX-FileCopyrightText: 2022 Amyspark <amy@amyspark.me>
+// SPDX-License-Identifier: BSD-3-Clause
+
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+
+#include "ycbcr_coefficients.h"
+
+namespace ycbcr
+{
+// The BT.2100 transfer functions, with linear light scaled so that 1 is the
+// reference white, as in the profile pipelines. Highlights go above 1, up
+// to pqPeak() and hlgPeak().
+
+// PQ signal -> display light.
+// Source: ITU-R BT.2100-2, table 4
+inline double pqEOTF(double signal)
+{
+    const auto p = std::pow(std::clamp(signal, 0.0, 1.0), 1.0 / pqM2);
+    return std::pow(std::max(p - pqC1, 0.0) / (pqC2 - pqC3 * p), 1.0 / pqM1) * pqPeakLuminance / hdrReferenceWhite;
+}
+
+// Display light -> PQ signal.
+inline double pqInverseEOTF(double linear)
+{
+    const auto y = std::pow(std::clamp(linear * hdrReferenceWhite / pqPeakLuminance, 0.0, 1.0), pqM1);
+    return std::pow((pqC1 + pqC2 * y) / (1 + pqC3 * y), pqM2);
+}
+
+// HLG signal -> scene light, unscaled (1 at the signal 1).
+// Source: ITU-R BT.2100-2, table 5
+inline double hlgInverseOETFUnscaled(double signal)
+{
+    signal = std::max(signal, 0.0);
+    return signal <= 0.5 ? signal * signal / 3 : (std::exp((signal - hlgC) / hlgA) + hlgB) / 12;
+}
+
+// Scene light of the HLG reference white, unscaled.
+inline double hlgReferenceLight()
+{
+    return hlgInverseOETFUnscaled(hlgReferenceSignal);
+}
+
+// HLG signal -> scene light. The OOTF, which mixes the channels through
+// their luminance, is left to the display.
+inline double hlgInverseOETF(double signal)
+{
+    return hlgInverseOETFUnscaled(signal) / hlgReferenceLight();
+}
+
+// Scene light -> HLG signal.
+inline double hlgOETF(double linear)
+{
+    const auto e = std::max(linear * hlgReferenceLight(), 0.0);
+    return e <= 1.0 / 12 ? std::sqrt(3 * e) : hlgA * std::log(12 * e - hlgB) + hlgC;
+}
+
+// Linear light of the signal 1.
+inline double pqPeak()
+{
+    return pqPeakLuminance / hdrReferenceWhite;
+}
+
+inline double hlgPeak()
+{
+    return 1 / hlgReferenceLight();
+}
+} // namespace ycbcr
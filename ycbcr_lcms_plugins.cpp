@@ -0,0 +1,107 @@
+// SPDX-FileCopyrightText: 2022 Amyspark <amy@amyspark.me>
+// SPDX-License-Identifier: BSD-3-Clause
+
+#include "ycbcr_lcms_plugins.h"
+
+#include <iostream>
+#include <sstream>
+
+#ifdef YCBCR_HAVE_LCMS2_FAST_FLOAT
+#include <lcms2_fast_float.h>
+#endif
+#ifdef YCBCR_HAVE_LCMS2_THREADED
+#include <lcms2_threaded.h>
+#endif
+
+namespace ycbcr
+{
+namespace
+{
+constexpr LcmsPlugin allPlugins[] = {LcmsPlugin::FastFloat, LcmsPlugin::Threaded};
+} // namespace
+
+const char *lcmsPluginName(LcmsPlugin plugin)
+{
+    return plugin == LcmsPlugin::FastFloat ? "fast_float" : "threaded";
+}
+
+bool hasLcmsPlugin(LcmsPlugin plugin)
+{
+    switch (plugin) {
+    case LcmsPlugin::FastFloat:
+#ifdef YCBCR_HAVE_LCMS2_FAST_FLOAT
+        return true;
+#else
+        return false;
+#endif
+    case LcmsPlugin::Threaded:
+#ifdef YCBCR_HAVE_LCMS2_THREADED
+        return true;
+#else
+        return false;
+#endif
+    }
+    return false;
+}
+
+bool parseLcmsPlugins(const std::string &list, std::vector<LcmsPlugin> &plugins)
+{
+    plugins.clear();
+    std::stringstream stream(list);
+    std::string item;
+    while (std::getline(stream, item, ',')) {
+        if (item.empty() || item == "none") {
+            continue;
+        }
+        bool found = false;
+        for (const auto plugin : allPlugins) {
+            if (item == lcmsPluginName(plugin)) {
+                if (!hasLcmsPlugin(plugin)) {
+                    std::cerr << "Built without the " << item << " plugin" << std::endl;
+                    return false;
+                }
+                plugins.push_back(plugin);
+                found = true;
+            }
+        }
+        if (!found) {
+            std::cerr << "Unknown LittleCMS plugin: " << item << std::endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+std::string lcmsPluginsName(const std::vector<LcmsPlugin> &plugins)
+{
+    std::string name;
+    for (const auto plugin : plugins) {
+        name += (name.empty() ? "" : ",") + std::string{lcmsPluginName(plugin)};
+    }
+    return name.empty() ? "none" : name;
+}
+
+bool registerLcmsPlugins(cmsContext ctx, const std::vector<LcmsPlugin> &plugins)
+{
+    for (const auto plugin : plugins) {
+        void *data = nullptr;
+        switch (plugin) {
+        case LcmsPlugin::FastFloat:
+#ifdef YCBCR_HAVE_LCMS2_FAST_FLOAT
+            data = cmsFastFloatExtensions();
+#endif
+            break;
+        case LcmsPlugin::Threaded:
+#ifdef YCBCR_HAVE_LCMS2_THREADED
+            data = cmsThreadedExtensions(CMS_THREADED_GUESS_MAX_THREADS, 0);
+#endif
+            break;
+        }
+        if (!data || !cmsPluginTHR(ctx, data)) {
+            std::cerr << "Cannot register the " << lcmsPluginName(plugin) << " plugin" << std::endl;
+            return false;
+        }
+    }
+    return true;
+}
+} // namespace ycbcr
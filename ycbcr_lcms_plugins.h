@@ -0,0 +1,38 @@
+// SPDX-FileCopyrightText: 2022 Amyspark <amy@amyspark.me>
+// SPDX-License-Identifier: BSD-3-Clause
+
+#pragma once
+
+#include <lcms2.h>
+
+#include <string>
+#include <vector>
+
+namespace ycbcr
+{
+// The optional plugins distributed with LittleCMS 2.14 and later, if the
+// build found them:
+//
+// - FastFloat (lcms2_fast_float) replaces the 8-bit, 16-bit and floating
+//   point optimizations and formatters with faster, slightly less accurate
+//   ones. It's licensed under the GPL v3.
+// - Threaded (lcms2_threaded) splits every cmsDoTransform call across a
+//   pool of threads.
+enum class LcmsPlugin { FastFloat, Threaded };
+
+// fast_float or threaded.
+const char *lcmsPluginName(LcmsPlugin plugin);
+
+// Whether the plugin was available at build time.
+bool hasLcmsPlugin(LcmsPlugin plugin);
+
+// Parses a comma separated list of plugin names. Returns false, with an
+// error on std::cerr, if a name is unknown or the plugin wasn't built.
+bool parseLcmsPlugins(const std::string &list, std::vector<LcmsPlugin> &plugins);
+
+// The plugins' names, comma separated, or none.
+std::string lcmsPluginsName(const std::vector<LcmsPlugin> &plugins);
+
+// Registers the plugins in ctx. Returns false on failure.
+bool registerLcmsPlugins(cmsContext ctx, const std::vector<LcmsPlugin> &plugins);
+} // namespace ycbcr
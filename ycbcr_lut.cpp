@@ -0,0 +1,112 @@
+// SPDX-FileCopyrightText: 2022 Amyspark <amy@amyspark.me>
+// SPDX-License-Identifier: BSD-3-Clause
+
+#include "ycbcr_lut.h"
+
+#include <algorithm>
+#include <array>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+#include "ycbcr_reference.h"
+
+namespace ycbcr
+{
+namespace
+{
+// Formats one slice of the grid, i.e. every entry whose slowest varying
+// index is slice: blue for .cube, red for CLF.
+std::string formatSlice(const Params &params, const LutParams &lut, cmsUInt32Number slice)
+{
+    const auto n = lut.size;
+    const auto step = 1.0 / static_cast<cmsFloat64Number>(n - 1);
+    std::string text;
+    // Up to 3 numbers of 10 characters, e.g. -0.123456, per line.
+    text.reserve(static_cast<size_t>(n) * n * 32);
+    std::array<char, 128> line{};
+    for (cmsUInt32Number j = 0; j < n; j++) {
+        for (cmsUInt32Number i = 0; i < n; i++) {
+            // .cube varies red fastest, CLF blue.
+            const auto fast = i * step;
+            const auto middle = j * step;
+            const auto slow = slice * step;
+            const Triplet in = lut.format == LutFormat::Cube ? Triplet{fast, middle, slow} : Triplet{slow, middle, fast};
+            const auto out = lut.direction == LutDirection::YCbCrToRGB ? yCbCrToRGB(params, in) : rgbToYCbCr(params, in);
+            const auto length = std::snprintf(line.data(), line.size(), "%.6f %.6f %.6f\n", out[0], out[1], out[2]);
+            text.append(line.data(), static_cast<size_t>(std::max(length, 0)));
+        }
+    }
+    return text;
+}
+
+void writeHeader(std::ostream &out, const Params &params, const LutParams &lut, const std::string &name)
+{
+    const auto description = lutDescription(params, lut);
+    if (lut.format == LutFormat::Cube) {
+        out << "TITLE \"" << description << "\"\n"
+            << "LUT_3D_SIZE " << lut.size << '\n'
+            << "DOMAIN_MIN 0 0 0\n"
+            << "DOMAIN_MAX 1 1 1\n";
+        return;
+    }
+    // The description goes into XML attributes and elements, so it must not
+    // hold any markup; the profile names don't.
+    const auto id = name.substr(0, name.find_last_of('.'));
+    out << "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+        << "<ProcessList id=\"" << id << "\" name=\"" << description << "\" compCLFversion=\"3.0\">\n"
+        << "    <Description>" << description << "</Description>\n"
+        << "    <LUT3D id=\"" << id << "_lut\" inBitDepth=\"32f\" outBitDepth=\"32f\" interpolation=\"tetrahedral\">\n"
+        << "        <Array dim=\"" << lut.size << ' ' << lut.size << ' ' << lut.size << " 3\">\n";
+}
+
+void writeFooter(std::ostream &out, const LutParams &lut)
+{
+    if (lut.format == LutFormat::CLF) {
+        out << "        </Array>\n"
+            << "    </LUT3D>\n"
+            << "</ProcessList>\n";
+    }
+}
+} // namespace
+
+bool writeLut(const std::string &path, const Params &params, const LutParams &lut, unsigned int threads)
+{
+    std::ofstream file(path, std::ios::binary);
+    if (!file) {
+        std::cerr << "CANNOT WRITE LUT " << path << std::endl;
+        return false;
+    }
+
+    writeHeader(file, params, lut, path.substr(path.find_last_of("/\\") + 1));
+
+    // Each round formats one slice per thread, then writes them in order.
+    std::vector<std::string> slices(std::max(1U, threads));
+    for (cmsUInt32Number first = 0; first < lut.size; first += static_cast<cmsUInt32Number>(slices.size())) {
+        const auto count = std::min<size_t>(slices.size(), lut.size - first);
+        std::vector<std::thread> workers;
+        for (size_t i = 1; i < count; i++) {
+            workers.emplace_back([&, i]() {
+                slices[i] = formatSlice(params, lut, first + static_cast<cmsUInt32Number>(i));
+            });
+        }
+        slices[0] = formatSlice(params, lut, first);
+        for (auto &t : workers) {
+            t.join();
+        }
+        for (size_t i = 0; i < count; i++) {
+            file << slices[i];
+        }
+    }
+
+    writeFooter(file, lut);
+    file.flush();
+    if (!file) {
+        std::cerr << "CANNOT WRITE LUT " << path << std::endl;
+        return false;
+    }
+    return true;
+}
+} // namespace ycbcr
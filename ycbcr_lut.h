@@ -0,0 +1,22 @@
+// SPDX-FileCopyrightText: 2022 Amyspark <amy@amyspark.me>
+// SPDX-License-Identifier: BSD-3-Clause
+
+#pragma once
+
+#include <string>
+
+#include "ycbcr_profile.h"
+
+namespace ycbcr
+{
+// Writes the YCbCr <-> R'G'B' conversion of params as a .cube (Adobe/Resolve)
+// or CLF (Academy/ASC Common LUT Format 3) 3D LUT, evaluated with the
+// analytic pipeline rather than the profiles' CLUTs. The YCbCr side is in the
+// profile's range, with the chroma channels offset to [0, 1] when full range;
+// the output isn't clipped.
+//
+// The grid is evaluated and formatted on threads, a slice at a time, and
+// streamed to the file in order, so that memory use doesn't grow with its
+// size. Returns false on failure.
+bool writeLut(const std::string &path, const Params &params, const LutParams &lut, unsigned int threads);
+} // namespace ycbcr
@@ -0,0 +1,531 @@
+// SPDX-FileCopyrightText: 2022 Amyspark <amy@amyspark.me>
+// SPDX-License-Identifier: BSD-3-Clause
+
+#include "ycbcr_optimization.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <limits>
+#include <memory>
+#include <vector>
+
+namespace ycbcr
+{
+namespace
+{
+// Number of intervals of the curve tables used by 8- and 16-bit transforms.
+constexpr size_t tableSize = 4096;
+
+// Largest difference between a CLUT node and the affine map fitted to the
+// CLUT. The nodes are sampled at inputs quantized to 16 bits, which moves
+// them up to ~1.5e-5 away from the map.
+constexpr cmsFloat64Number affineTolerance = 1e-4;
+
+// Type of the stage that replaces the optimized pipeline.
+const auto fusedStageType = static_cast<cmsStageSignature>(0x79636678); // 'ycfx'
+
+struct Affine {
+    std::array<cmsFloat64Number, 3 * 3> matrix;
+    std::array<cmsFloat64Number, 3> offset;
+    // Clamp the input to [0, 1] first, as lcms does before looking up a
+    // CLUT.
+    bool clampInput;
+};
+
+constexpr Affine identityAffine = {{1, 0, 0, 0, 1, 0, 0, 0, 1}, {0, 0, 0}, false};
+
+// second(first(x)). second must not clamp its input.
+Affine compose(const Affine &first, const Affine &second)
+{
+    Affine result{};
+    for (size_t i = 0; i < 3; i++) {
+        for (size_t j = 0; j < 3; j++) {
+            for (size_t k = 0; k < 3; k++) {
+                result.matrix[i * 3 + j] += second.matrix[i * 3 + k] * first.matrix[k * 3 + j];
+            }
+        }
+        result.offset[i] = second.offset[i];
+        for (size_t k = 0; k < 3; k++) {
+            result.offset[i] += second.matrix[i * 3 + k] * first.offset[k];
+        }
+    }
+    result.clampInput = first.clampInput;
+    return result;
+}
+
+// Same as lcms' CLUT interpolators.
+cmsFloat32Number clamp(cmsFloat32Number v)
+{
+    return (v < 1.0e-9f || std::isnan(v)) ? 0.0f : std::min(v, 1.0f);
+}
+
+// Same arithmetic as lcms' matrix stage: double accumulation, float result.
+void evalAffine(const Affine &affine, const cmsFloat32Number in[3], cmsFloat32Number out[3])
+{
+    std::array<cmsFloat32Number, 3> x = {in[0], in[1], in[2]};
+    if (affine.clampInput) {
+        for (auto &v : x) {
+            v = clamp(v);
+        }
+    }
+    for (size_t i = 0; i < 3; i++) {
+        cmsFloat64Number v = affine.offset[i];
+        for (size_t j = 0; j < 3; j++) {
+            v += affine.matrix[i * 3 + j] * x[j];
+        }
+        out[i] = static_cast<cmsFloat32Number>(v);
+    }
+}
+
+// Single precision copy of an affine map, for the 8- and 16-bit path.
+struct AffineFloat {
+    AffineFloat() = default;
+
+    explicit AffineFloat(const Affine &affine)
+        : clampInput(affine.clampInput)
+    {
+        std::transform(affine.matrix.begin(), affine.matrix.end(), matrix.begin(), [](cmsFloat64Number v) { return static_cast<cmsFloat32Number>(v); });
+        std::transform(affine.offset.begin(), affine.offset.end(), offset.begin(), [](cmsFloat64Number v) { return static_cast<cmsFloat32Number>(v); });
+    }
+
+    void eval(const cmsFloat32Number in[3], cmsFloat32Number out[3]) const
+    {
+        auto x0 = in[0];
+        auto x1 = in[1];
+        auto x2 = in[2];
+        if (clampInput) {
+            x0 = clamp(x0);
+            x1 = clamp(x1);
+            x2 = clamp(x2);
+        }
+        out[0] = matrix[0] * x0 + matrix[1] * x1 + matrix[2] * x2 + offset[0];
+        out[1] = matrix[3] * x0 + matrix[4] * x1 + matrix[5] * x2 + offset[1];
+        out[2] = matrix[6] * x0 + matrix[7] * x1 + matrix[8] * x2 + offset[2];
+    }
+
+    std::array<cmsFloat32Number, 3 * 3> matrix{};
+    std::array<cmsFloat32Number, 3> offset{};
+    bool clampInput = false;
+};
+
+struct Range {
+    cmsFloat32Number min;
+    cmsFloat32Number max;
+};
+
+using Ranges = std::array<Range, 3>;
+
+// The range of each output channel, given the range of the inputs.
+Ranges affineRanges(const Affine &affine, Ranges in)
+{
+    if (affine.clampInput) {
+        for (auto &r : in) {
+            r = {clamp(r.min), clamp(r.max)};
+        }
+    }
+    Ranges out{};
+    for (size_t i = 0; i < 3; i++) {
+        auto min = affine.offset[i];
+        auto max = affine.offset[i];
+        for (size_t j = 0; j < 3; j++) {
+            const auto a = affine.matrix[i * 3 + j] * in[j].min;
+            const auto b = affine.matrix[i * 3 + j] * in[j].max;
+            min += std::min(a, b);
+            max += std::max(a, b);
+        }
+        out[i] = {static_cast<cmsFloat32Number>(min), static_cast<cmsFloat32Number>(max)};
+    }
+    return out;
+}
+
+// A step of the pipeline, once identities are dropped and adjacent
+// matrices joined.
+struct Step {
+    bool isCurves;
+    Affine affine;
+    std::array<const cmsToneCurve *, 3> curves;
+};
+
+// Fits an affine map to a 3 -> 3 CLUT, from its corners, and checks that
+// every node lies on it.
+bool affineFromCLut(const cmsStage *mpe, Affine &affine)
+{
+    const auto *data = static_cast<const _cmsStageCLutData *>(cmsStageData(mpe));
+    const auto *params = data->Params;
+    const std::array<cmsUInt32Number, 3> n = {params->nSamples[0], params->nSamples[1], params->nSamples[2]};
+    if (n[0] < 2 || n[1] < 2 || n[2] < 2) {
+        return false;
+    }
+
+    // The last input varies the fastest.
+    const auto node = [&](cmsUInt32Number i0, cmsUInt32Number i1, cmsUInt32Number i2, size_t channel) -> cmsFloat64Number {
+        const auto index = ((static_cast<size_t>(i0) * n[1] + i1) * n[2] + i2) * 3 + channel;
+        return data->HasFloatValues ? data->Tab.TFloat[index] : data->Tab.T[index] / 65535.0;
+    };
+
+    for (size_t o = 0; o < 3; o++) {
+        affine.offset[o] = node(0, 0, 0, o);
+        affine.matrix[o * 3] = node(n[0] - 1, 0, 0, o) - affine.offset[o];
+        affine.matrix[o * 3 + 1] = node(0, n[1] - 1, 0, o) - affine.offset[o];
+        affine.matrix[o * 3 + 2] = node(0, 0, n[2] - 1, o) - affine.offset[o];
+    }
+    affine.clampInput = true;
+
+    for (cmsUInt32Number i0 = 0; i0 < n[0]; i0++) {
+        for (cmsUInt32Number i1 = 0; i1 < n[1]; i1++) {
+            for (cmsUInt32Number i2 = 0; i2 < n[2]; i2++) {
+                const std::array<cmsFloat64Number, 3> x = {i0 / (n[0] - 1.0), i1 / (n[1] - 1.0), i2 / (n[2] - 1.0)};
+                for (size_t o = 0; o < 3; o++) {
+                    auto expected = affine.offset[o];
+                    for (size_t j = 0; j < 3; j++) {
+                        expected += affine.matrix[o * 3 + j] * x[j];
+                    }
+                    if (!(std::fabs(node(i0, i1, i2, o) - expected) <= affineTolerance)) {
+                        return false;
+                    }
+                }
+            }
+        }
+    }
+    return true;
+}
+
+// Turns the pipeline into a list of steps. Returns false if it holds any
+// stage that is neither a matrix, a set of curves nor an affine CLUT.
+bool collectSteps(const cmsPipeline *lut, std::vector<Step> &steps)
+{
+    const auto pushAffine = [&steps](const Affine &affine) {
+        if (steps.empty() || steps.back().isCurves) {
+            steps.push_back({false, affine, {}});
+            return true;
+        }
+        // The clamp can only go at the start of an affine map.
+        if (affine.clampInput) {
+            return false;
+        }
+        steps.back().affine = compose(steps.back().affine, affine);
+        return true;
+    };
+
+    for (auto mpe = cmsPipelineGetPtrToFirstStage(lut); mpe; mpe = cmsStageNext(mpe)) {
+        if (cmsStageInputChannels(mpe) != 3 || cmsStageOutputChannels(mpe) != 3) {
+            return false;
+        }
+        switch (cmsStageType(mpe)) {
+        case cmsSigIdentityElemType:
+            break;
+        case cmsSigMatrixElemType: {
+            const auto *data = static_cast<const _cmsStageMatrixData *>(cmsStageData(mpe));
+            Affine affine{};
+            std::copy(data->Double, data->Double + 3 * 3, affine.matrix.begin());
+            if (data->Offset) {
+                std::copy(data->Offset, data->Offset + 3, affine.offset.begin());
+            }
+            if (!pushAffine(affine)) {
+                return false;
+            }
+            break;
+        }
+        case cmsSigCLutElemType: {
+            Affine affine{};
+            if (!affineFromCLut(mpe, affine) || !pushAffine(affine)) {
+                return false;
+            }
+            break;
+        }
+        case cmsSigCurveSetElemType: {
+            const auto *data = static_cast<const _cmsStageToneCurvesData *>(cmsStageData(mpe));
+            if (std::all_of(data->TheCurves, data->TheCurves + 3, cmsIsToneCurveLinear)) {
+                break;
+            }
+            // Two sets of curves in a row don't fit the fused shape.
+            if (!steps.empty() && steps.back().isCurves) {
+                return false;
+            }
+            steps.push_back({true, identityAffine, {data->TheCurves[0], data->TheCurves[1], data->TheCurves[2]}});
+            break;
+        }
+        default:
+            return false;
+        }
+    }
+    return true;
+}
+
+// A set of curves, along with its tables for the 8- and 16-bit path.
+class CurveSet
+{
+public:
+    CurveSet(const std::array<const cmsToneCurve *, 3> &source)
+    {
+        for (size_t i = 0; i < 3; i++) {
+            curves[i] = cmsDupToneCurve(source[i]);
+        }
+    }
+
+    ~CurveSet()
+    {
+        for (auto *curve : curves) {
+            if (curve) {
+                cmsFreeToneCurve(curve);
+            }
+        }
+    }
+
+    CurveSet(const CurveSet &) = delete;
+    CurveSet &operator=(const CurveSet &) = delete;
+
+    bool isValid() const
+    {
+        return std::all_of(curves.begin(), curves.end(), [](const cmsToneCurve *c) { return c != nullptr; });
+    }
+
+    // Samples each curve over the range its input can take, and returns
+    // the range of its output.
+    Ranges tabulate(const Ranges &in)
+    {
+        Ranges out{};
+        for (size_t i = 0; i < 3; i++) {
+            const auto min = in[i].min;
+            const auto width = std::max(in[i].max - in[i].min, 1e-6f);
+            origin[i] = min;
+            scale[i] = static_cast<cmsFloat32Number>(tableSize) / width;
+            tables[i].resize(tableSize + 1);
+            out[i] = {std::numeric_limits<cmsFloat32Number>::max(), std::numeric_limits<cmsFloat32Number>::lowest()};
+            for (size_t j = 0; j <= tableSize; j++) {
+                const auto v = cmsEvalToneCurveFloat(curves[i], min + width * static_cast<cmsFloat32Number>(j) / tableSize);
+                tables[i][j] = v;
+                out[i] = {std::min(out[i].min, v), std::max(out[i].max, v)};
+            }
+        }
+        return out;
+    }
+
+    void eval(const cmsFloat32Number in[3], cmsFloat32Number out[3]) const
+    {
+        for (size_t i = 0; i < 3; i++) {
+            out[i] = cmsEvalToneCurveFloat(curves[i], in[i]);
+        }
+    }
+
+    // Linear interpolation in the tables. Values out of their range (only
+    // possible through rounding) go to the curves themselves.
+    void lookup(const cmsFloat32Number in[3], cmsFloat32Number out[3]) const
+    {
+        for (size_t i = 0; i < 3; i++) {
+            const auto x = (in[i] - origin[i]) * scale[i];
+            if (!(x >= 0.0f && x <= static_cast<cmsFloat32Number>(tableSize))) {
+                out[i] = cmsEvalToneCurveFloat(curves[i], in[i]);
+                continue;
+            }
+            const auto j = std::min(static_cast<size_t>(x), tableSize - 1);
+            const auto f = x - static_cast<cmsFloat32Number>(j);
+            const auto *t = tables[i].data() + j;
+            out[i] = t[0] + f * (t[1] - t[0]);
+        }
+    }
+
+private:
+    std::array<cmsToneCurve *, 3> curves{};
+    std::array<cmsFloat32Number, 3> origin{};
+    std::array<cmsFloat32Number, 3> scale{};
+    std::array<std::vector<cmsFloat32Number>, 3> tables;
+};
+
+// [curves] -> affine -> curves -> affine -> [curves]
+struct FusedPipeline {
+    std::unique_ptr<CurveSet> input;
+    Affine first = identityAffine;
+    std::unique_ptr<CurveSet> middle;
+    Affine second = identityAffine;
+    std::unique_ptr<CurveSet> output;
+    AffineFloat firstFloat;
+    AffineFloat secondFloat;
+
+    // Builds the curve tables. 8- and 16-bit inputs are always in [0, 1].
+    void tabulate()
+    {
+        firstFloat = AffineFloat(first);
+        secondFloat = AffineFloat(second);
+        Ranges ranges{{{0, 1}, {0, 1}, {0, 1}}};
+        if (input) {
+            ranges = input->tabulate(ranges);
+        }
+        ranges = affineRanges(first, ranges);
+        if (middle) {
+            ranges = middle->tabulate(ranges);
+        }
+        ranges = affineRanges(second, ranges);
+        if (output) {
+            output->tabulate(ranges);
+        }
+    }
+
+    // Exact, for floating point transforms.
+    void eval(const cmsFloat32Number in[3], cmsFloat32Number out[3]) const
+    {
+        std::array<cmsFloat32Number, 3> a{in[0], in[1], in[2]};
+        std::array<cmsFloat32Number, 3> b{};
+        if (input) {
+            input->eval(a.data(), a.data());
+        }
+        evalAffine(first, a.data(), b.data());
+        if (middle) {
+            middle->eval(b.data(), b.data());
+        }
+        evalAffine(second, b.data(), a.data());
+        if (output) {
+            output->eval(a.data(), a.data());
+        }
+        std::copy(a.begin(), a.end(), out);
+    }
+
+    // Through the tables, in single precision.
+    void lookup(const cmsFloat32Number in[3], cmsFloat32Number out[3]) const
+    {
+        std::array<cmsFloat32Number, 3> a{in[0], in[1], in[2]};
+        std::array<cmsFloat32Number, 3> b{};
+        if (input) {
+            input->lookup(a.data(), a.data());
+        }
+        firstFloat.eval(a.data(), b.data());
+        if (middle) {
+            middle->lookup(b.data(), b.data());
+        }
+        secondFloat.eval(b.data(), a.data());
+        if (output) {
+            output->lookup(a.data(), a.data());
+        }
+        std::copy(a.begin(), a.end(), out);
+    }
+};
+
+using SharedPipeline = std::shared_ptr<const FusedPipeline>;
+
+// Lays the steps out in the fused shape. Returns nullptr if they don't fit.
+SharedPipeline fuse(const std::vector<Step> &steps)
+{
+    auto fused = std::make_shared<FusedPipeline>();
+    // Slots in order: input curves, first affine, middle curves, second
+    // affine, output curves.
+    size_t slot = 0;
+    for (const auto &step : steps) {
+        // Curves go in the even slots, affine maps in the odd ones.
+        while (slot < 5 && (slot % 2 == 0) != step.isCurves) {
+            slot++;
+        }
+        if (slot == 5) {
+            return nullptr;
+        }
+        if (step.isCurves) {
+            auto set = std::make_unique<CurveSet>(step.curves);
+            if (!set->isValid()) {
+                return nullptr;
+            }
+            (slot == 0 ? fused->input : slot == 2 ? fused->middle : fused->output) = std::move(set);
+        } else {
+            (slot == 1 ? fused->first : fused->second) = step.affine;
+        }
+        slot++;
+    }
+    fused->tabulate();
+    return fused;
+}
+
+void evalFused16(CMSREGISTER const cmsUInt16Number in[], CMSREGISTER cmsUInt16Number out[], const void *data)
+{
+    const auto &fused = **static_cast<const SharedPipeline *>(data);
+    constexpr auto scale = 1.0f / 65535.0f;
+    const std::array<cmsFloat32Number, 3> x = {in[0] * scale, in[1] * scale, in[2] * scale};
+    std::array<cmsFloat32Number, 3> y{};
+    fused.lookup(x.data(), y.data());
+    for (size_t i = 0; i < 3; i++) {
+        out[i] = _cmsQuickSaturateWord(y[i] * 65535.0);
+    }
+}
+
+void evalFusedFloat(const cmsFloat32Number in[], cmsFloat32Number out[], const cmsStage *mpe)
+{
+    const auto &fused = **static_cast<const SharedPipeline *>(cmsStageData(mpe));
+    fused.eval(in, out);
+}
+
+void *dupStageData(cmsStage *mpe)
+{
+    return new SharedPipeline(*static_cast<const SharedPipeline *>(cmsStageData(mpe)));
+}
+
+void freeStageData(cmsStage *mpe)
+{
+    delete static_cast<SharedPipeline *>(cmsStageData(mpe));
+}
+
+void *dupPipelineData(cmsContext, const void *data)
+{
+    return new SharedPipeline(*static_cast<const SharedPipeline *>(data));
+}
+
+void freePipelineData(cmsContext, void *data)
+{
+    delete static_cast<SharedPipeline *>(data);
+}
+
+cmsBool optimize(cmsPipeline **lut, cmsUInt32Number, cmsUInt32Number *inputFormat, cmsUInt32Number *outputFormat, cmsUInt32Number *)
+{
+    // Leave RGB to RGB and the like to lcms' own matrix-shaper path.
+    if (T_COLORSPACE(*inputFormat) != PT_YCbCr && T_COLORSPACE(*outputFormat) != PT_YCbCr) {
+        return FALSE;
+    }
+    if (cmsPipelineInputChannels(*lut) != 3 || cmsPipelineOutputChannels(*lut) != 3) {
+        return FALSE;
+    }
+
+    std::vector<Step> steps;
+    if (!collectSteps(*lut, steps)) {
+        return FALSE;
+    }
+    auto fused = fuse(steps);
+    if (!fused) {
+        return FALSE;
+    }
+
+    auto ctx = cmsGetPipelineContextID(*lut);
+    auto optimized = cmsPipelineAlloc(ctx, 3, 3);
+    if (!optimized) {
+        return FALSE;
+    }
+    // Floating point transforms go through the stage, the others through
+    // the 16-bit evaluator.
+    auto *stageData = new SharedPipeline(fused);
+    auto stage = _cmsStageAllocPlaceholder(ctx, fusedStageType, 3, 3, evalFusedFloat, dupStageData, freeStageData, stageData);
+    if (!stage) {
+        delete stageData;
+        cmsPipelineFree(optimized);
+        return FALSE;
+    }
+    if (!cmsPipelineInsertStage(optimized, cmsAT_END, stage)) {
+        cmsStageFree(stage);
+        cmsPipelineFree(optimized);
+        return FALSE;
+    }
+    _cmsPipelineSetOptimizationParameters(optimized, evalFused16, new SharedPipeline(fused), freePipelineData, dupPipelineData);
+
+    cmsPipelineFree(*lut);
+    *lut = optimized;
+    return TRUE;
+}
+
+cmsPluginOptimization plugin = {{cmsPluginMagicNumber, 2000, cmsPluginOptimizationSig, nullptr}, optimize};
+} // namespace
+
+cmsPluginBase *optimizationPlugin()
+{
+    return &plugin.base;
+}
+
+bool registerOptimization(cmsContext ctx)
+{
+    return cmsPluginTHR(ctx, optimizationPlugin()) != FALSE;
+}
+} // namespace ycbcr
@@ -0,0 +1,31 @@
+// SPDX-FileCopyrightText: 2022 Amyspark <amy@amyspark.me>
+// SPDX-License-Identifier: BSD-3-Clause
+
+#pragma once
+
+#include <lcms2.h>
+#include <lcms2_plugin.h>
+
+namespace ycbcr
+{
+// An optimization plugin for transforms from or to YCbCr.
+//
+// The pipelines of the generated profiles are, once linked to an RGB
+// display, a chain of 3x3 matrices (with offsets), curves, and, for the
+// floating point profiles, CLUTs that only hold an affine map. lcms can
+// neither join the matrices that carry offsets nor see through the CLUTs,
+// so it resamples the whole chain into a 3D CLUT (8 and 16 bits) or runs
+// every stage for every pixel (floating point).
+//
+// The plugin folds such pipelines into
+//
+//   [curves] -> matrix + offset -> curves -> matrix + offset -> [curves]
+//
+// and evaluates them in one go: with tabulated curves for 8 and 16 bits,
+// with the exact curves for floating point. Any other pipeline is left to
+// lcms.
+cmsPluginBase *optimizationPlugin();
+
+// Registers the plugin in ctx. Returns false on failure.
+bool registerOptimization(cmsContext ctx);
+} // namespace ycbcr
@@ -0,0 +1,1080 @@
+// SPDX-FileCopyrightText: 2022 Amyspark <amy@amyspark.me>
+// SPDX-License-Identifier: BSD-3-Clause
+
+#include "ycbcr_profile.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <utility>
+
+#include "version.h"
+#include "ycbcr_hdr.h"
+#include "ycbcr_sampler.h"
+
+namespace ycbcr
+{
+namespace
+{
+size_t index(Curve curve)
+{
+    return static_cast<size_t>(curve);
+}
+
+// Workaround littleCMS going haywire on type 5 parametric curves
+std::array<cmsFloat32Number, curveSamples> sampleCurve(const cmsToneCurve *curve)
+{
+    std::array<cmsFloat32Number, curveSamples> test{};
+    for (size_t i = 0; i < curveSamples; i++) {
+        cmsFloat32Number x = 1.0f / 1024.0f * (cmsFloat32Number)i;
+        test[i] = cmsEvalToneCurveFloat(curve, x);
+    }
+    return test;
+}
+
+// The Rec.601/709 curves, split at the breakpoint into two type 6
+// segments ((a * x + b) ^ gamma + c), the only formula shape the
+// DToB0/BToD0 tags can store besides the sampled one.
+cmsToneCurve *buildSegmentedEOTF(cmsContext ctx)
+{
+    const auto &p = rec709ParametersInv;
+    std::array<cmsCurveSegment, 2> segments{};
+    // x < 0.081: x / 4.5
+    segments[0].x0 = -1e22f;
+    segments[0].x1 = static_cast<cmsFloat32Number>(p[4]);
+    segments[0].Type = 6;
+    segments[0].Params[0] = 1;
+    segments[0].Params[1] = p[3];
+    // x >= 0.081: ((x + 0.099) / 1.099) ^ (1 / 0.45)
+    segments[1].x0 = segments[0].x1;
+    segments[1].x1 = 1e22f;
+    segments[1].Type = 6;
+    segments[1].Params[0] = p[0];
+    segments[1].Params[1] = p[1];
+    segments[1].Params[2] = p[2];
+    return cmsBuildSegmentedToneCurve(ctx, segments.size(), segments.data());
+}
+
+cmsToneCurve *buildSegmentedOETF(cmsContext ctx)
+{
+    const auto &p = rec709Parameters;
+    std::array<cmsCurveSegment, 2> segments{};
+    // x < 0.018: 4.5 * x
+    segments[0].x0 = -1e22f;
+    segments[0].x1 = static_cast<cmsFloat32Number>(p[4]);
+    segments[0].Type = 6;
+    segments[0].Params[0] = 1;
+    segments[0].Params[1] = p[3];
+    // x >= 0.018: 1.099 * x ^ 0.45 - 0.099
+    segments[1].x0 = segments[0].x1;
+    segments[1].x1 = 1e22f;
+    segments[1].Type = 6;
+    segments[1].Params[0] = p[0];
+    segments[1].Params[1] = p[1];
+    segments[1].Params[3] = p[5];
+    return cmsBuildSegmentedToneCurve(ctx, segments.size(), segments.data());
+}
+
+// Samples of the AToB0/BToA0 curves of PQ and HLG.
+constexpr size_t clippedCurveSamples = 4096;
+
+// Largest error of the sampled PQ curves, in signal values: a quarter of a
+// 12-bit code value, the depth PQ is designed to show no banding at.
+constexpr double pqTolerance = 0.25 / 4095;
+
+// Ratio between the ends of each sampled segment of the inverse PQ EOTF.
+constexpr double pqSegmentRatio = 8;
+
+// f on [0, 1], clipped to [0, 1], for the 16-bit tags: HDR curves lose
+// everything above the reference white there.
+cmsToneCurve *buildClippedCurve(cmsContext ctx, double (*f)(double))
+{
+    std::vector<cmsFloat32Number> samples(clippedCurveSamples);
+    for (size_t i = 0; i < samples.size(); i++) {
+        const auto x = static_cast<double>(i) / static_cast<double>(samples.size() - 1);
+        samples[i] = static_cast<cmsFloat32Number>(std::clamp(f(x), 0.0, 1.0));
+    }
+    return cmsBuildTabulatedToneCurveFloat(ctx, static_cast<cmsUInt32Number>(samples.size()), samples.data());
+}
+
+// A segment of n samples of f, evenly spaced on [x0, x1].
+cmsCurveSegment sampleSegment(double (*f)(double), double x0, double x1, size_t n, std::vector<std::vector<cmsFloat32Number>> &storage)
+{
+    storage.emplace_back(n);
+    auto &samples = storage.back();
+    for (size_t i = 0; i < n; i++) {
+        samples[i] = static_cast<cmsFloat32Number>(f(x0 + (x1 - x0) * static_cast<double>(i) / static_cast<double>(n - 1)));
+    }
+    cmsCurveSegment segment{};
+    segment.x0 = static_cast<cmsFloat32Number>(x0);
+    segment.x1 = static_cast<cmsFloat32Number>(x1);
+    segment.Type = 0;
+    segment.nGridPoints = static_cast<cmsUInt32Number>(n);
+    segment.SampledPoints = samples.data();
+    return segment;
+}
+
+// Largest error, in PQ signal values, of the linear interpolation of a
+// sampled segment of the PQ EOTF or, if inverse, of its inverse.
+double pqSegmentError(const cmsCurveSegment &segment, bool inverse)
+{
+    constexpr size_t checksPerSample = 8;
+    double error = 0;
+    for (size_t i = 0; i + 1 < segment.nGridPoints; i++) {
+        for (size_t k = 1; k < checksPerSample; k++) {
+            const auto t = static_cast<double>(k) / checksPerSample;
+            const auto x = segment.x0 + (segment.x1 - segment.x0) * (static_cast<double>(i) + t) / static_cast<double>(segment.nGridPoints - 1);
+            const auto y = (1 - t) * segment.SampledPoints[i] + t * segment.SampledPoints[i + 1];
+            error = std::max(error, inverse ? std::abs(y - pqInverseEOTF(x)) : std::abs(pqInverseEOTF(y) - x));
+        }
+    }
+    return error;
+}
+
+// The PQ EOTF, sampled at the fewest evenly spaced signal values (a power
+// of two plus one) within pqTolerance.
+cmsToneCurve *buildSampledPQEOTF(cmsContext ctx)
+{
+    std::vector<std::vector<cmsFloat32Number>> storage;
+    for (size_t n = 65; n <= 65537; n = n * 2 - 1) {
+        storage.clear();
+        if (pqSegmentError(sampleSegment(pqEOTF, 0, 1, n, storage), false) <= pqTolerance) {
+            break;
+        }
+    }
+    const auto &samples = storage.back();
+    return cmsBuildTabulatedToneCurveFloat(ctx, static_cast<cmsUInt32Number>(samples.size()), samples.data());
+}
+
+// The inverse PQ EOTF, whose slope goes from infinite at black to tiny in
+// the highlights, as sampled segments spanning pqSegmentRatio of linear
+// light each, down to where a last one, from black, stays within
+// pqTolerance. Every segment takes the fewest samples (the same power of
+// two plus one) that keep all of them within pqTolerance.
+cmsToneCurve *buildSampledPQInverseEOTF(cmsContext ctx)
+{
+    constexpr size_t maxSegments = 64;
+    std::vector<std::vector<cmsFloat32Number>> storage;
+    std::vector<cmsCurveSegment> segments;
+    for (size_t n = 5; n <= 4097; n = n * 2 - 1) {
+        storage.clear();
+        segments.clear();
+        // Below black: black.
+        cmsCurveSegment below{};
+        below.x0 = -1e22f;
+        below.x1 = 0;
+        below.Type = 6;
+        below.Params[0] = 1;
+        below.Params[3] = pqInverseEOTF(0);
+        segments.push_back(below);
+
+        std::vector<cmsCurveSegment> sampled;
+        for (auto upper = pqPeak(); sampled.size() < maxSegments; upper /= pqSegmentRatio) {
+            const auto bottom = sampleSegment(pqInverseEOTF, 0, upper, n, storage);
+            if (pqSegmentError(bottom, true) <= pqTolerance) {
+                sampled.push_back(bottom);
+                break;
+            }
+            storage.pop_back();
+            sampled.push_back(sampleSegment(pqInverseEOTF, upper / pqSegmentRatio, upper, n, storage));
+        }
+        segments.insert(segments.end(), sampled.rbegin(), sampled.rend());
+
+        // Above the peak: the signal 1.
+        cmsCurveSegment above{};
+        above.x0 = segments.back().x1;
+        above.x1 = 1e22f;
+        above.Type = 6;
+        above.Params[0] = 1;
+        above.Params[3] = 1;
+        segments.push_back(above);
+
+        if (std::all_of(sampled.begin(), sampled.end(), [](const cmsCurveSegment &segment) {
+                return pqSegmentError(segment, true) <= pqTolerance;
+            })) {
+            break;
+        }
+    }
+    return cmsBuildSegmentedToneCurve(ctx, static_cast<cmsUInt32Number>(segments.size()), segments.data());
+}
+
+// The HLG inverse OETF, scaled like hlgInverseOETF, as a type 6 segment
+// ((a * x + b) ^ gamma + c) and a type 8 one (a * b ^ (c * x + d) + e).
+cmsToneCurve *buildSegmentedHLGInverseOETF(cmsContext ctx)
+{
+    const auto scale = hlgPeak();
+    std::array<cmsCurveSegment, 2> segments{};
+    // x <= 0.5: x ^ 2 / 3
+    segments[0].x0 = -1e22f;
+    segments[0].x1 = 0.5f;
+    segments[0].Type = 6;
+    segments[0].Params[0] = 2;
+    segments[0].Params[1] = std::sqrt(scale / 3);
+    // x > 0.5: (e ^ ((x - c) / a) + b) / 12
+    segments[1].x0 = segments[0].x1;
+    segments[1].x1 = 1e22f;
+    segments[1].Type = 8;
+    segments[1].Params[0] = scale / 12;
+    segments[1].Params[1] = std::exp(1.0);
+    segments[1].Params[2] = 1 / hlgA;
+    segments[1].Params[3] = -hlgC / hlgA;
+    segments[1].Params[4] = scale * hlgB / 12;
+    return cmsBuildSegmentedToneCurve(ctx, segments.size(), segments.data());
+}
+
+// The HLG OETF, as a type 6 segment and a type 7 one
+// (a * log10(b * x ^ gamma + c) + d).
+cmsToneCurve *buildSegmentedHLGOETF(cmsContext ctx)
+{
+    const auto scale = hlgPeak();
+    std::array<cmsCurveSegment, 2> segments{};
+    // x <= 1 / 12: sqrt(3 * x)
+    segments[0].x0 = -1e22f;
+    segments[0].x1 = static_cast<cmsFloat32Number>(scale / 12);
+    segments[0].Type = 6;
+    segments[0].Params[0] = 0.5;
+    segments[0].Params[1] = 3 / scale;
+    // x > 1 / 12: a * ln(12 * x - b) + c
+    segments[1].x0 = segments[0].x1;
+    segments[1].x1 = 1e22f;
+    segments[1].Type = 7;
+    segments[1].Params[0] = 1;
+    segments[1].Params[1] = hlgA * std::log(10.0);
+    segments[1].Params[2] = 12 / scale;
+    segments[1].Params[3] = -hlgB;
+    segments[1].Params[4] = hlgC;
+    return cmsBuildSegmentedToneCurve(ctx, segments.size(), segments.data());
+}
+
+const char *rangeFileSuffix(Range range)
+{
+    switch (range) {
+    case Range::Limited8:
+        return "_limited8";
+    case Range::Limited10:
+        return "_limited10";
+    default:
+        return "";
+    }
+}
+
+const char *curveFileSuffix(Curve curve)
+{
+    switch (curve) {
+    case Curve::BT1886:
+        return "_bt1886";
+    case Curve::PQ:
+        return "_pq";
+    case Curve::HLG:
+        return "_hlg";
+    default:
+        return "";
+    }
+}
+
+const char *curveDescription(Curve curve)
+{
+    switch (curve) {
+    case Curve::BT1886:
+        return " + BT.1886";
+    case Curve::PQ:
+        return " + BT.2100-2 PQ";
+    case Curve::HLG:
+        return " + BT.2100-2 HLG";
+    default:
+        return "";
+    }
+}
+
+const char *rangeDescription(Range range)
+{
+    switch (range) {
+    case Range::Limited8:
+        return " 8-bit limited range";
+    case Range::Limited10:
+        return " 10-bit limited range";
+    default:
+        return "";
+    }
+}
+
+const char *displayName(Display display)
+{
+    switch (display) {
+    case Display::DisplayP3:
+        return "Display P3";
+    case Display::BT709:
+        return "BT.709 RGB";
+    default:
+        return "sRGB";
+    }
+}
+
+// The YCbCr offset stage: the range mapping of the samples.
+cmsStage *allocRangeStage(cmsContext ctx, Range range)
+{
+    const auto mapping = rangeMapping(range);
+    std::array<double, 3 * 3> scale{};
+    for (size_t i = 0; i < 3; i++) {
+        scale[i * 3 + i] = mapping.scale[i];
+    }
+    return cmsStageAllocMatrix(ctx, T_CHANNELS(TYPE_YCbCr_16), T_CHANNELS(TYPE_YCbCr_16), scale.data(), mapping.offset.data());
+}
+
+// Normalized R'G'B -> YCbCr, followed by the inverse of the range mapping.
+cmsStage *allocEncodeStage(cmsContext ctx, Standard standard, Range range)
+{
+    const auto &c = coefficients(standard);
+    const auto mapping = rangeMapping(range);
+    std::array<double, 3 * 3> matrix{};
+    std::array<double, 3> offset{};
+    for (size_t i = 0; i < 3; i++) {
+        for (size_t j = 0; j < 3; j++) {
+            matrix[i * 3 + j] = c.rgb_to_ycbcr[i * 3 + j] / mapping.scale[i];
+        }
+        // 0 - x rather than -x, so that a zero offset isn't stored as -0.
+        offset[i] = (0 - mapping.offset[i]) / mapping.scale[i];
+    }
+    return cmsStageAllocMatrix(ctx, T_CHANNELS(TYPE_RGB_16), T_CHANNELS(TYPE_YCbCr_16), matrix.data(), offset.data());
+}
+
+// Largest deviation of the fitted shaper tables from the warp.
+constexpr double shaperTolerance = 1.0 / 1024;
+
+// The CIE L* function, scaled to [0, 1], warping the CLUT grid of the
+// fitted shapers so that it is spaced evenly in lightness.
+constexpr double labEpsilon = 216.0 / 24389.0;
+constexpr double labKappa = 24389.0 / 27.0;
+
+double shaperWarp(double x)
+{
+    return x > labEpsilon ? 1.16 * std::cbrt(x) - 0.16 : labKappa * x / 100.0;
+}
+
+double shaperWarpInverse(double y)
+{
+    return y > labKappa * labEpsilon / 100.0 ? std::pow((y + 0.16) / 1.16, 3) : 100.0 * y / labKappa;
+}
+
+// Samples f at the fewest evenly spaced points (a power of two, within the
+// 2 to 4096 entries of a lut16Type table) whose linear interpolation stays
+// within shaperTolerance of f. Only the grid warp depends on it: the CLUT
+// is sampled through the exact inverse of the table.
+std::vector<cmsUInt16Number> fitShaper(double (*f)(double))
+{
+    constexpr size_t checksPerEntry = 16;
+    std::vector<cmsUInt16Number> table;
+    for (size_t entries = 16; entries <= 4096; entries *= 2) {
+        table.resize(entries);
+        for (size_t i = 0; i < entries; i++) {
+            const auto x = static_cast<double>(i) / static_cast<double>(entries - 1);
+            table[i] = static_cast<cmsUInt16Number>(std::lround(std::clamp(f(x), 0.0, 1.0) * 65535.0));
+        }
+        double error = 0;
+        for (size_t i = 0; i + 1 < entries; i++) {
+            for (size_t k = 1; k < checksPerEntry; k++) {
+                const auto t = static_cast<double>(k) / checksPerEntry;
+                const auto x = (static_cast<double>(i) + t) / static_cast<double>(entries - 1);
+                const auto interpolated = ((1 - t) * table[i] + t * table[i + 1]) / 65535.0;
+                error = std::max(error, std::abs(interpolated - f(x)));
+            }
+        }
+        if (error <= shaperTolerance) {
+            break;
+        }
+    }
+    return table;
+}
+
+// The inverse of the linear interpolation of table, exactly, as one
+// linear segment per entry.
+cmsToneCurve *invertShaper(cmsContext ctx, const std::vector<cmsUInt16Number> &table)
+{
+    const auto step = 1.0 / static_cast<double>(table.size() - 1);
+    std::vector<cmsCurveSegment> segments;
+    for (size_t i = 0; i + 1 < table.size(); i++) {
+        const auto y0 = table[i] / 65535.0;
+        const auto y1 = table[i + 1] / 65535.0;
+        if (y1 <= y0) {
+            continue;
+        }
+        // x = (a * y + b) ^ 1 + 0
+        cmsCurveSegment segment{};
+        segment.x0 = segments.empty() ? -1e22f : segments.back().x1;
+        segment.x1 = i + 2 == table.size() ? 1e22f : static_cast<cmsFloat32Number>(y1);
+        segment.Type = 6;
+        segment.Params[0] = 1;
+        segment.Params[1] = step / (y1 - y0);
+        segment.Params[2] = static_cast<double>(i) * step - y0 * segment.Params[1];
+        segments.push_back(segment);
+    }
+    return cmsBuildSegmentedToneCurve(ctx, static_cast<cmsUInt32Number>(segments.size()), segments.data());
+}
+
+// A stage of three copies of curve.
+cmsStage *allocCurvesStage(cmsContext ctx, cmsToneCurve *curve)
+{
+    const std::array<cmsToneCurve *, 3> curves = {curve, curve, curve};
+    return cmsStageAllocToneCurves(ctx, curves.size(), curves.data());
+}
+
+void setupMetadata(cmsContext ctx, cmsHPROFILE profile, const std::string &descriptionText, Storage storage)
+{
+    std::string version{COMMIT};
+
+    auto copyright = cmsMLUalloc(ctx, 1);
+    if (storage == Storage::Compact) {
+        cmsMLUsetASCII(copyright, "en", "US", "(C) 2022 Amyspark <amy@amyspark.me>, CC BY-SA 4.0");
+    } else {
+        cmsMLUsetASCII(copyright,
+                       "en",
+                       "US",
+                       "(C) 2022 Amyspark <amy@amyspark.me>. This work is licensed under the Creative Commons Attribution-ShareAlike 4.0 International License. To "
+                       "view a copy of this license, visit <http://creativecommons.org/licenses/by-sa/4.0/>.");
+    }
+    cmsWriteTag(profile, cmsSigCopyrightTag, copyright);
+    cmsMLUfree(copyright);
+
+    auto description = cmsMLUalloc(ctx, 1);
+    cmsMLUsetASCII(description, "en", "US", descriptionText.c_str());
+    cmsWriteTag(profile, cmsSigProfileDescriptionTag, description);
+    cmsMLUfree(description);
+    cmsSetHeaderManufacturer(profile, 0x494E544C);
+    cmsSetHeaderModel(profile, 0x494E544C);
+    // The device descriptions are optional.
+    if (storage == Storage::Compact) {
+        return;
+    }
+    auto MfgDesc = cmsMLUalloc(ctx, 1);
+    cmsMLUsetASCII(MfgDesc, "en", "US", "Amyspark");
+    cmsWriteTag(profile, cmsSigDeviceMfgDescTag, MfgDesc);
+    cmsMLUfree(MfgDesc);
+    auto ModelDesc = cmsMLUalloc(ctx, 1);
+    cmsMLUsetASCII(ModelDesc, "en", "US", version.c_str());
+    cmsWriteTag(profile, cmsSigDeviceModelDescTag, ModelDesc);
+    cmsMLUfree(ModelDesc);
+}
+
+// Points every tag whose contents are identical to an earlier one's to
+// that tag, so that the data is only stored once.
+void linkIdenticalTags(cmsHPROFILE profile)
+{
+    std::vector<std::pair<cmsTagSignature, std::vector<cmsUInt8Number>>> stored;
+    const auto count = cmsGetTagCount(profile);
+    for (cmsInt32Number i = 0; i < count; i++) {
+        const auto sig = cmsGetTagSignature(profile, static_cast<cmsUInt32Number>(i));
+        if (cmsTagLinkedTo(profile, sig)) {
+            continue;
+        }
+        std::vector<cmsUInt8Number> data(cmsReadRawTag(profile, sig, nullptr, 0));
+        if (data.empty() || cmsReadRawTag(profile, sig, data.data(), static_cast<cmsUInt32Number>(data.size())) != data.size()) {
+            continue;
+        }
+        const auto same = std::find_if(stored.begin(), stored.end(), [&](const std::pair<cmsTagSignature, std::vector<cmsUInt8Number>> &tag) {
+            return tag.second == data;
+        });
+        if (same != stored.end()) {
+            cmsLinkTag(profile, sig, same->first);
+        } else {
+            stored.emplace_back(sig, std::move(data));
+        }
+    }
+}
+
+cmsHPROFILE createProfileV2(cmsContext ctx, const SharedData &shared, const TransferCurves &curves, const Params &params, unsigned int threads)
+{
+    const auto &c = coefficients(params.standard);
+
+    auto yCbrProfile = cmsCreateLab2ProfileTHR(ctx, &d65);
+    if (!yCbrProfile) {
+        return nullptr;
+    }
+    setupMetadata(ctx, yCbrProfile, profileDescription(params), params.storage);
+
+    // Strict transformation between YCbCr and XYZ
+    if (params.curve == Curve::BT1886 || params.curve == Curve::PQ) {
+        cmsSetDeviceClass(yCbrProfile, cmsSigDisplayClass);
+    } else {
+        cmsSetDeviceClass(yCbrProfile, cmsSigColorSpaceClass);
+    }
+    cmsSetColorSpace(yCbrProfile, cmsSigYCbCrData);
+    cmsSetPCS(yCbrProfile, cmsSigXYZData);
+    cmsSetHeaderRenderingIntent(yCbrProfile, INTENT_PERCEPTUAL);
+
+    // The YCbCr -> XYZ conversion goes as follows:
+    auto yCbrPipeline = cmsPipelineAlloc(ctx, T_CHANNELS(TYPE_YCbCr_16), T_CHANNELS(TYPE_XYZ_16));
+    // 0. Dummy curves for the "gamma"-corrected YCbCr.
+    auto pipeline1_M = cmsStageAllocToneCurves(ctx, T_CHANNELS(TYPE_YCbCr_16), nullptr);
+    // 1. Chrominance channels are [-0.5, 0.5]. Adjust.
+    // The offset (and, for limited range, the scale) is pre-applied before
+    // the transform.
+    auto yCbrOffset = allocRangeStage(ctx, params.range);
+    // 2. YCbCr -> normalized R'G'B.
+    auto yCbrMatrix = cmsStageAllocMatrix(ctx, T_CHANNELS(TYPE_YCbCr_16), T_CHANNELS(TYPE_RGB_16), c.ycbcr_to_rgb.data(), nullptr);
+    // 2. Normalized R'G'B -> linear RGB.
+    // The BT.601/709 curve is sampled to work around littleCMS going haywire
+    // on type 5 parametric curves.
+    auto trc = params.curve == Curve::BT1886 ? curves.eotf : curves.eotfFloat;
+    const std::array<cmsToneCurve *, T_CHANNELS(TYPE_RGB_16)> gamma = {trc, trc, trc};
+    auto pipeline1_B = cmsStageAllocToneCurves(ctx, T_CHANNELS(TYPE_RGB_16), gamma.data());
+    // 3. Linear RGB -> XYZ.
+    auto pipeline1_C = cmsStageAllocMatrix(ctx, T_CHANNELS(TYPE_RGB_16), T_CHANNELS(TYPE_XYZ_16), c.rgb_to_xyz.data(), nullptr);
+
+    // Assemble the YCbCr -> XYZ pipeline.
+    cmsPipelineInsertStage(yCbrPipeline, cmsAT_END, yCbrOffset);
+    cmsPipelineInsertStage(yCbrPipeline, cmsAT_END, yCbrMatrix);
+    cmsPipelineInsertStage(yCbrPipeline, cmsAT_END, pipeline1_B); // M = OETF
+    cmsPipelineInsertStage(yCbrPipeline, cmsAT_END, pipeline1_C); // Matrix = RGB -> XYZ
+
+    // With the fitted shaper, the CLUT holds the warped XYZ, and the B
+    // curves unwarp it.
+    auto pipeline1_Out = cmsStageDup(pipeline1_M);
+    if (params.shaper == Shaper::Fitted) {
+        const auto table = fitShaper(shaperWarpInverse);
+        auto unwarp = cmsBuildTabulatedToneCurve16(ctx, static_cast<cmsUInt32Number>(table.size()), table.data());
+        auto warp = invertShaper(ctx, table);
+        cmsPipelineInsertStage(yCbrPipeline, cmsAT_END, allocCurvesStage(ctx, warp));
+        cmsStageFree(pipeline1_Out);
+        pipeline1_Out = allocCurvesStage(ctx, unwarp);
+        cmsFreeToneCurve(warp);
+        cmsFreeToneCurve(unwarp);
+    }
+
+    auto lut1 = cmsStageAllocCLut16bit(ctx, clutResolution(yCbrPipeline, params.resolution, true), T_CHANNELS(TYPE_YCbCr_16), T_CHANNELS(TYPE_XYZ_16), nullptr);
+    sampleCLut16bit(lut1, yCbrPipeline, threads);
+
+    // This LUT is then saved to the profile
+    auto p = cmsPipelineAlloc(ctx, T_CHANNELS(TYPE_YCbCr_16), T_CHANNELS(TYPE_XYZ_16));
+    cmsPipelineInsertStage(p, cmsAT_END, pipeline1_M); // A = dummy curves
+    // The CLUT is needed because AtoB0 in v2 can only pack a CLUT.
+    cmsPipelineInsertStage(p, cmsAT_END, lut1);          // CLUT = YCbr -> XYZ
+    cmsPipelineInsertStage(p, cmsAT_END, pipeline1_Out); // B = dummy or shaper curves
+    if (params.clutPrecision == CLutPrecision::UInt8) {
+        cmsPipelineSetSaveAs8bitsFlag(p, TRUE);
+    }
+    cmsWriteTag(yCbrProfile, cmsSigAToB0Tag, p);
+
+    // The XYZ -> YCbCr conversion goes as follows:
+    auto yCbrPipeline2 = cmsPipelineAlloc(ctx, T_CHANNELS(TYPE_XYZ_16), T_CHANNELS(TYPE_YCbCr_16));
+    // 0. Dummy curves for the gamma-uncorrected YCbCr.
+    auto pipeline2_M = cmsStageAllocToneCurves(ctx, T_CHANNELS(TYPE_RGB_16), nullptr);
+    // 1. XYZ -> Linear RGB.
+    auto pipeline2_C = cmsStageAllocMatrix(ctx, T_CHANNELS(TYPE_XYZ_16), T_CHANNELS(TYPE_RGB_16), c.xyz_to_rgb.data(), nullptr);
+    // 2. Linear RGB -> Normalized R'G'B.
+    // Workaround littleCMS going haywire on type 5 parametric curves
+    auto trcI = params.curve == Curve::BT1886 ? curves.oetf : curves.oetfFloat;
+    const std::array<cmsToneCurve *, T_CHANNELS(TYPE_RGB_16)> gamma_i = {trcI, trcI, trcI};
+    auto pipeline2_B = cmsStageAllocToneCurves(ctx, T_CHANNELS(TYPE_RGB_16), gamma_i.data());
+    // 3. Normalized R'G'B -> YCbCr.
+    // 4. Chrominance channels are [-0.5, 0.5]. Adjust.
+    // The offset (and range scale) is applied after the transform, so no
+    // additional matrix is needed.
+    auto pipeline2_Matrix = allocEncodeStage(ctx, params.standard, params.range);
+
+    cmsPipelineInsertStage(yCbrPipeline2, cmsAT_END, pipeline2_C); // Matrix = XYZ -> RGB
+    cmsPipelineInsertStage(yCbrPipeline2, cmsAT_END, pipeline2_B); // M = OETF^-1
+    cmsPipelineInsertStage(yCbrPipeline2, cmsAT_END, pipeline2_Matrix);
+
+    // With the fitted shaper, the B curves warp XYZ, and the CLUT takes
+    // the warped XYZ.
+    auto pipeline2_In = cmsStageDup(pipeline2_M);
+    if (params.shaper == Shaper::Fitted) {
+        const auto table = fitShaper(shaperWarp);
+        auto warp = cmsBuildTabulatedToneCurve16(ctx, static_cast<cmsUInt32Number>(table.size()), table.data());
+        auto unwarp = invertShaper(ctx, table);
+        cmsPipelineInsertStage(yCbrPipeline2, cmsAT_BEGIN, allocCurvesStage(ctx, unwarp));
+        cmsStageFree(pipeline2_In);
+        pipeline2_In = allocCurvesStage(ctx, warp);
+        cmsFreeToneCurve(warp);
+        cmsFreeToneCurve(unwarp);
+    }
+
+    auto lut2 = cmsStageAllocCLut16bit(ctx, clutResolution(yCbrPipeline2, params.resolution, true), T_CHANNELS(TYPE_XYZ_16), T_CHANNELS(TYPE_YCbCr_16), nullptr);
+    sampleCLut16bit(lut2, yCbrPipeline2, threads);
+
+    auto p2 = cmsPipelineAlloc(ctx, T_CHANNELS(TYPE_XYZ_16), T_CHANNELS(TYPE_YCbCr_16));
+
+    cmsPipelineInsertStage(p2, cmsAT_END, pipeline2_In); // B = dummy or shaper curves
+    cmsPipelineInsertStage(p2, cmsAT_END, lut2);         // CLUT = R'G'B' -> YCbr
+    cmsPipelineInsertStage(p2, cmsAT_END, pipeline2_M);  // A = dummy
+    if (params.clutPrecision == CLutPrecision::UInt8) {
+        cmsPipelineSetSaveAs8bitsFlag(p2, TRUE);
+    }
+    cmsWriteTag(yCbrProfile, cmsSigBToA0Tag, p2);
+
+    cmsWriteTag(yCbrProfile, cmsSigChromaticAdaptationTag, shared.chromaticAdaptation.data());
+
+    // The tags hold copies of the pipelines, which own their stages.
+    for (auto *pipeline : {yCbrPipeline, p, yCbrPipeline2, p2}) {
+        cmsPipelineFree(pipeline);
+    }
+
+    return yCbrProfile;
+}
+
+cmsHPROFILE createProfileV4(cmsContext ctx, const SharedData &shared, const TransferCurves &curves, const Params &params, unsigned int threads)
+{
+    const auto &c = coefficients(params.standard);
+
+    auto yCbrProfile = cmsCreateLab4ProfileTHR(ctx, &d65);
+    if (!yCbrProfile) {
+        return nullptr;
+    }
+    setupMetadata(ctx, yCbrProfile, profileDescription(params), params.storage);
+
+    // Strict transformation between YCbCr and XYZ
+    if (params.curve == Curve::BT1886 || params.curve == Curve::PQ) {
+        cmsSetDeviceClass(yCbrProfile, cmsSigDisplayClass);
+    } else {
+        cmsSetDeviceClass(yCbrProfile, cmsSigColorSpaceClass);
+    }
+    cmsSetColorSpace(yCbrProfile, cmsSigYCbCrData);
+    cmsSetPCS(yCbrProfile, cmsSigXYZData);
+    cmsSetHeaderRenderingIntent(yCbrProfile, INTENT_PERCEPTUAL);
+
+    // The YCbCr -> XYZ conversion goes as follows:
+    auto yCbrPipeline = cmsPipelineAlloc(ctx, T_CHANNELS(TYPE_YCbCr_16), T_CHANNELS(TYPE_XYZ_16));
+    // 0. Dummy curves for the "gamma"-corrected YCbCr.
+    auto pipeline1_M = cmsStageAllocToneCurves(ctx, T_CHANNELS(TYPE_YCbCr_16), nullptr);
+    // 1. Chrominance channels are [-0.5, 0.5]. Adjust.
+    // The offset (and, for limited range, the scale) is pre-applied before
+    // the transform.
+    auto yCbrOffset = allocRangeStage(ctx, params.range);
+    // 2. YCbCr -> normalized R'G'B.
+    auto yCbrMatrix = cmsStageAllocMatrix(ctx, T_CHANNELS(TYPE_YCbCr_16), T_CHANNELS(TYPE_RGB_16), c.ycbcr_to_rgb.data(), nullptr);
+    // 2. Normalized R'G'B -> linear RGB.
+    const std::array<cmsToneCurve *, T_CHANNELS(TYPE_RGB_16)> gamma = {curves.eotf, curves.eotf, curves.eotf};
+    auto pipeline1_B = cmsStageAllocToneCurves(ctx, T_CHANNELS(TYPE_RGB_16), gamma.data());
+    // 3. Linear RGB -> XYZ.
+    auto pipeline1_C = cmsStageAllocMatrix(ctx, T_CHANNELS(TYPE_RGB_16), T_CHANNELS(TYPE_XYZ_16), c.rgb_to_xyz.data(), nullptr);
+
+    // Assemble the YCbCr -> R'G'B' pipeline.
+    cmsPipelineInsertStage(yCbrPipeline, cmsAT_END, yCbrOffset);
+    cmsPipelineInsertStage(yCbrPipeline, cmsAT_END, yCbrMatrix);
+
+    // The CLUT is needed because AtoB0 can't pack the matrices. Its nodes
+    // are clamped to [0, 1], and most YCbCr values fall outside of R'G'B',
+    // so unlike the others it needs the full grid.
+    auto lut1 = cmsStageAllocCLut16bit(ctx, clutResolution(yCbrPipeline, params.resolution, true), T_CHANNELS(TYPE_YCbCr_16), T_CHANNELS(TYPE_RGB_16), nullptr);
+    sampleCLut16bit(lut1, yCbrPipeline, threads);
+
+    // This LUT is then saved to the profile
+    // ICC 4.3 requires two dummy M and B curves
+    auto p = cmsPipelineAlloc(ctx, T_CHANNELS(TYPE_YCbCr_16), T_CHANNELS(TYPE_XYZ_16));
+    cmsPipelineInsertStage(p, cmsAT_END, pipeline1_M);              // A = dummy curves
+    cmsPipelineInsertStage(p, cmsAT_END, lut1);                     // CLUT = YCbr -> R'G'B
+    cmsPipelineInsertStage(p, cmsAT_END, pipeline1_B);              // M = OETF
+    cmsPipelineInsertStage(p, cmsAT_END, pipeline1_C);              // Matrix = RGB -> XYZ
+    cmsPipelineInsertStage(p, cmsAT_END, cmsStageDup(pipeline1_M)); // B = dummy curves
+    if (params.clutPrecision == CLutPrecision::UInt8) {
+        cmsPipelineSetSaveAs8bitsFlag(p, TRUE);
+    }
+    cmsWriteTag(yCbrProfile, cmsSigAToB0Tag, p);
+
+    // Add DtoB0 tag as requested by Wolthera.
+    auto d2b0 = cmsPipelineAlloc(ctx, T_CHANNELS(TYPE_YCbCr_16), T_CHANNELS(TYPE_XYZ_16));
+    if (params.precision == Precision::Float) {
+        // Same layout as AToB0, but the CLUT is sampled and stored in
+        // floating point, and the curves are exact.
+        auto lutD1 = cmsStageAllocCLutFloat(ctx, clutResolution(yCbrPipeline, params.resolution, false), T_CHANNELS(TYPE_YCbCr_16), T_CHANNELS(TYPE_RGB_16), nullptr);
+        sampleCLutFloat(lutD1, yCbrPipeline, threads);
+        const std::array<cmsToneCurve *, T_CHANNELS(TYPE_RGB_16)> gammaExact = {curves.eotfSegmented, curves.eotfSegmented, curves.eotfSegmented};
+        auto *pipelineD1_B = cmsStageAllocToneCurves(ctx, T_CHANNELS(TYPE_RGB_16), gammaExact.data());
+        cmsPipelineInsertStage(d2b0, cmsAT_END, lutD1);                    // CLUT = YCbr -> R'G'B
+        cmsPipelineInsertStage(d2b0, cmsAT_END, pipelineD1_B);             // M = OETF
+        cmsPipelineInsertStage(d2b0, cmsAT_END, cmsStageDup(pipeline1_C)); // Matrix = RGB -> XYZ
+    } else {
+        // The Rec.601/709 parametric curve is incompatible with the available
+        // shapes, it must be sampled (this is the same workaround as in v2),
+        // unless the profile is compact, in which case it's split into
+        // formula segments like in the floating point profiles.
+        auto trc = params.storage == Storage::Compact ? curves.eotfSegmented : curves.eotfFloat;
+        const std::array<cmsToneCurve *, T_CHANNELS(TYPE_RGB_16)> gammaClut = {trc, trc, trc};
+        auto *pipelineD1_B = cmsStageAllocToneCurves(ctx, T_CHANNELS(TYPE_RGB_16), gammaClut.data());
+        cmsPipelineInsertStage(d2b0, cmsAT_END, cmsStageDup(yCbrOffset));
+        cmsPipelineInsertStage(d2b0, cmsAT_END, cmsStageDup(yCbrMatrix));
+        cmsPipelineInsertStage(d2b0, cmsAT_END, pipelineD1_B);              // M = OETF
+        cmsPipelineInsertStage(d2b0, cmsAT_END, cmsStageDup(pipeline1_C));  // Matrix = RGB -> XYZ
+    }
+    cmsWriteTag(yCbrProfile, cmsSigDToB0Tag, d2b0);
+
+    // The XYZ -> YCbCr conversion goes as follows:
+    auto yCbrPipeline2 = cmsPipelineAlloc(ctx, T_CHANNELS(TYPE_XYZ_16), T_CHANNELS(TYPE_YCbCr_16));
+    // 0. Dummy curves for the gamma-uncorrected YCbCr.
+    auto pipeline2_M = cmsStageAllocToneCurves(ctx, T_CHANNELS(TYPE_RGB_16), nullptr);
+    // 1. XYZ -> Linear RGB.
+    auto pipeline2_C = cmsStageAllocMatrix(ctx, T_CHANNELS(TYPE_XYZ_16), T_CHANNELS(TYPE_RGB_16), c.xyz_to_rgb.data(), nullptr);
+    // 2. Linear RGB -> Normalized R'G'B.
+    const std::array<cmsToneCurve *, T_CHANNELS(TYPE_RGB_16)> gamma_i = {curves.oetf, curves.oetf, curves.oetf};
+    auto pipeline2_B = cmsStageAllocToneCurves(ctx, T_CHANNELS(TYPE_RGB_16), gamma_i.data());
+    // 3. Normalized R'G'B -> YCbCr.
+    // 4. Chrominance channels are [-0.5, 0.5]. Adjust.
+    // The offset (and range scale) is applied after the transform, so no
+    // additional matrix is needed.
+    auto pipeline2_Matrix = allocEncodeStage(ctx, params.standard, params.range);
+
+    cmsPipelineInsertStage(yCbrPipeline2, cmsAT_END, pipeline2_Matrix);
+
+    // R'G'B' always falls within YCbCr, so the CLUT of this affine map only
+    // needs the corners of the cube.
+    auto lut2 = cmsStageAllocCLut16bit(ctx, clutResolution(yCbrPipeline2, params.resolution, true), T_CHANNELS(TYPE_RGB_16), T_CHANNELS(TYPE_YCbCr_16), nullptr);
+    sampleCLut16bit(lut2, yCbrPipeline2, threads);
+
+    auto p2 = cmsPipelineAlloc(ctx, T_CHANNELS(TYPE_XYZ_16), T_CHANNELS(TYPE_YCbCr_16));
+    cmsPipelineInsertStage(p2, cmsAT_END, pipeline2_M);              // B = dummy
+    cmsPipelineInsertStage(p2, cmsAT_END, pipeline2_C);              // Matrix = XYZ -> RGB
+    cmsPipelineInsertStage(p2, cmsAT_END, pipeline2_B);              // M = OETF^-1
+    cmsPipelineInsertStage(p2, cmsAT_END, lut2);                     // CLUT = R'G'B' -> YCbr
+    cmsPipelineInsertStage(p2, cmsAT_END, cmsStageDup(pipeline2_M)); // A = dummy
+    if (params.clutPrecision == CLutPrecision::UInt8) {
+        cmsPipelineSetSaveAs8bitsFlag(p2, TRUE);
+    }
+    cmsWriteTag(yCbrProfile, cmsSigBToA0Tag, p2);
+
+    // Add BtoD0 tag as requested by Wolthera.
+    auto b2d0 = cmsPipelineAlloc(ctx, T_CHANNELS(TYPE_YCbCr_16), T_CHANNELS(TYPE_XYZ_16));
+    if (params.precision == Precision::Float) {
+        auto lutD2 = cmsStageAllocCLutFloat(ctx, clutResolution(yCbrPipeline2, params.resolution, false), T_CHANNELS(TYPE_RGB_16), T_CHANNELS(TYPE_YCbCr_16), nullptr);
+        sampleCLutFloat(lutD2, yCbrPipeline2, threads);
+        const std::array<cmsToneCurve *, T_CHANNELS(TYPE_RGB_16)> gammaIExact = {curves.oetfSegmented, curves.oetfSegmented, curves.oetfSegmented};
+        auto *pipelineD2_B = cmsStageAllocToneCurves(ctx, T_CHANNELS(TYPE_RGB_16), gammaIExact.data());
+        cmsPipelineInsertStage(b2d0, cmsAT_END, cmsStageDup(pipeline2_C)); // Matrix = XYZ -> RGB
+        cmsPipelineInsertStage(b2d0, cmsAT_END, pipelineD2_B);             // M = OETF^-1
+        cmsPipelineInsertStage(b2d0, cmsAT_END, lutD2);                    // CLUT = R'G'B' -> YCbr
+    } else {
+        // Same as in DToB0.
+        auto trcI = params.storage == Storage::Compact ? curves.oetfSegmented : curves.oetfFloat;
+        const std::array<cmsToneCurve *, T_CHANNELS(TYPE_RGB_16)> gammaIClut = {trcI, trcI, trcI};
+        auto *pipeline2_B_Clut = cmsStageAllocToneCurves(ctx, T_CHANNELS(TYPE_RGB_16), gammaIClut.data());
+        cmsPipelineInsertStage(b2d0, cmsAT_END, cmsStageDup(pipeline2_C));      // Matrix = XYZ -> RGB
+        cmsPipelineInsertStage(b2d0, cmsAT_END, pipeline2_B_Clut);              // M = OETF^-1
+        cmsPipelineInsertStage(b2d0, cmsAT_END, cmsStageDup(pipeline2_Matrix)); // CLUT = R'G'B' -> YCbr
+    }
+    cmsWriteTag(yCbrProfile, cmsSigBToD0Tag, b2d0);
+
+    cmsWriteTag(yCbrProfile, cmsSigChromaticAdaptationTag, shared.chromaticAdaptation.data());
+
+    // The tags hold copies of the pipelines, which own their stages.
+    for (auto *pipeline : {yCbrPipeline, p, d2b0, yCbrPipeline2, p2, b2d0}) {
+        cmsPipelineFree(pipeline);
+    }
+
+    return yCbrProfile;
+}
+} // namespace
+
+// From the V4 profile above EXTRACT:
+// - cmsSigMediaWhitePointTag
+// - any of the cmsSigRedTRCTag, cmsSigGreenTRCTag, cmsSigBlueTRCTag
+// - cmsSigChromaticAdaptationTag
+// and use with the YCbCr profile
+cmsHPROFILE createBaseRec709Profile(cmsContext ctx, cmsToneCurve *toneCurveInv)
+{
+    const std::array<cmsToneCurve *, T_CHANNELS(TYPE_RGB_16)> curves = {toneCurveInv, toneCurveInv, toneCurveInv};
+
+    return cmsCreateRGBProfileTHR(ctx, &d65, &sRGBPrimariesPreQuantized, curves.data());
+}
+
+const char *displayFileName(Display display)
+{
+    switch (display) {
+    case Display::DisplayP3:
+        return "p3";
+    case Display::BT709:
+        return "bt709";
+    default:
+        return "srgb";
+    }
+}
+
+cmsHPROFILE createDisplayProfile(cmsContext ctx, Display display)
+{
+    if (display == Display::SRGB) {
+        return cmsCreate_sRGBProfileTHR(ctx);
+    }
+    cmsHPROFILE profile = nullptr;
+    if (display == Display::DisplayP3) {
+        auto curve = cmsBuildParametricToneCurve(ctx, 4, sRGBParameters.data());
+        const std::array<cmsToneCurve *, 3> curves = {curve, curve, curve};
+        profile = cmsCreateRGBProfileTHR(ctx, &d65, &displayP3Primaries, curves.data());
+        cmsFreeToneCurve(curve);
+    } else {
+        auto curve = cmsBuildParametricToneCurve(ctx, 4, rec709ParametersInv.data());
+        profile = createBaseRec709Profile(ctx, curve);
+        cmsFreeToneCurve(curve);
+    }
+    return profile;
+}
+
+std::string profileName(const Params &params)
+{
+    std::string name{coefficients(params.standard).fileName};
+    name += curveFileSuffix(params.curve);
+    name += "_ycbcr_v" + std::to_string(params.version);
+    name += rangeFileSuffix(params.range);
+    if (params.precision == Precision::Float) {
+        name += "_float";
+    }
+    if (params.shaper == Shaper::Fitted) {
+        name += "_shaper";
+    }
+    if (params.storage == Storage::Compact) {
+        name += "_compact";
+    }
+    if (params.clutPrecision == CLutPrecision::UInt8) {
+        name += "_clut8";
+    }
+    if (params.resolution != defaultResolution) {
+        name += "_" + std::to_string(params.resolution);
+    }
+    return name + ".icc";
+}
+
+std::string profileDescription(const Params &params)
+{
+    std::string description{coefficients(params.standard).name};
+    description += curveDescription(params.curve);
+    description += rangeDescription(params.range);
+    description += " YCbCr ICC V" + std::to_string(params.version) + " profile";
+    if (params.precision == Precision::Float) {
+        description += " (floating point)";
+    }
+    if (params.shaper == Shaper::Fitted) {
+        description += " (shaper curves)";
+    }
+    if (params.clutPrecision == CLutPrecision::UInt8) {
+        description += " (8-bit CLUT)";
+    }
+    return description;
+}
+
+std::string linkName(const Params &params, const LinkParams &link)
+{
+    auto name = profileName(params);
+    name.resize(name.size() - std::string{".icc"}.size());
+    name += "_to_";
+    name += displayFileName(link.display);
+    if (link.resolution != defaultLinkResolution) {
+        name += "_" + std::to_string(link.resolution);
+    }
+    return name + ".icc";
+}
+
+std::string linkDescription(const Params &params, const LinkParams &link)
+{
+    std::string description{coefficients(params.standard).name};
+    description += curveDescription(params.curve);
+    description += rangeDescription(params.range);
+    description += " YCbCr to ";
+    description += displayName(link.display);
+    description += " ICC V" + std::to_string(params.version) + " device link";
+    if (params.precision == Precision::Float) {
+        description += " (floating point)";
+    }
+    if (params.clutPrecision == CLutPrecision::UInt8) {
+        description += " (8-bit CLUT)";
+    }
+    return description;
+}
+
+std::string lutName(const Params &params, const LutParams &lut)
+{
+    std::string name{coefficients(params.standard).fileName};
+    name += rangeFileSuffix(params.range);
+    name += lut.direction == LutDirection::YCbCrToRGB ? "_ycbcr_to_rgb" : "_rgb_to_ycbcr";
+    name += "_" + std::to_string(lut.size);
+    return name + (lut.format == LutFormat::Cube ? ".cube" : ".clf");
+}
+
+std::string lutDescription(const Params &params, const LutParams &lut)
+{
+    std::string description{coefficients(params.standard).name};
+    description += rangeDescription(params.range);
+    description += lut.direction == LutDirection::YCbCrToRGB ? " YCbCr to R'G'B'" : " R'G'B' to YCbCr";
+    return description;
+}
+
+SharedData createSharedData(cmsContext ctx)
+{
+    SharedData shared{};
+
+    auto toneCurveInv = cmsBuildParametricToneCurve(ctx, 4, rec709ParametersInv.data());
+    auto baseProfile = createBaseRec709Profile(ctx, toneCurveInv);
+    // cmsSaveProfileToFile(baseProfile, "srgb.icc");
+
+    auto bradford = reinterpret_cast<const cmsFloat64Number *>(cmsReadTag(baseProfile, cmsSigChromaticAdaptationTag));
+    std::copy(bradford, bradford + shared.chromaticAdaptation.size(), shared.chromaticAdaptation.begin());
+
+    auto trc = reinterpret_cast<cmsToneCurve *>(cmsReadTag(baseProfile, cmsSigRedTRCTag));
+    shared.eotfSamples = sampleCurve(trc);
+
+    auto trcI = cmsBuildParametricToneCurve(ctx, 5, rec709Parameters.data());
+    shared.oetfSamples = sampleCurve(trcI);
+
+    cmsFreeToneCurve(trcI);
+    cmsCloseProfile(baseProfile);
+    cmsFreeToneCurve(toneCurveInv);
+
+    return shared;
+}
+
+std::vector<cmsUInt8Number> profileBytes(cmsHPROFILE profile)
+{
+    cmsUInt32Number size = 0;
+    if (!cmsSaveProfileToMem(profile, nullptr, &size)) {
+        return {};
+    }
+    std::vector<cmsUInt8Number> bytes(size);
+    if (!cmsSaveProfileToMem(profile, bytes.data(), &size)) {
+        return {};
+    }
+    return bytes;
+}
+
+ProfileBuilder::ProfileBuilder(cmsContext ctx, const SharedData &shared, unsigned int samplerThreads)
+    : ctx(ctx)
+    , shared(shared)
+    , samplerThreads(samplerThreads)
+    , curves()
+{
+    auto &oetf = curves[index(Curve::OETF)];
+    oetf.eotf = cmsBuildParametricToneCurve(ctx, 4, rec709ParametersInv.data());
+    oetf.oetf = cmsBuildParametricToneCurve(ctx, 5, rec709Parameters.data());
+    oetf.eotfFloat = cmsBuildTabulatedToneCurveFloat(ctx, shared.eotfSamples.size(), shared.eotfSamples.data());
+    oetf.oetfFloat = cmsBuildTabulatedToneCurveFloat(ctx, shared.oetfSamples.size(), shared.oetfSamples.data());
+    oetf.eotfSegmented = buildSegmentedEOTF(ctx);
+    oetf.oetfSegmented = buildSegmentedOETF(ctx);
+
+    auto &bt1886 = curves[index(Curve::BT1886)];
+    bt1886.eotf = cmsBuildGamma(ctx, bt1886Gamma);
+    bt1886.oetf = cmsBuildGamma(ctx, 1.0 / bt1886Gamma);
+    const std::array<cmsFloat64Number, 4> trcParameters = {bt1886Gamma, 1, 0, 0};
+    bt1886.eotfFloat = cmsBuildParametricToneCurve(ctx, 6, trcParameters.data());
+    const std::array<cmsFloat64Number, 4> trcIParameters = {1.0 / bt1886Gamma, 1, 0, 0};
+    bt1886.oetfFloat = cmsBuildParametricToneCurve(ctx, 6, trcIParameters.data());
+    // These are already exact.
+    bt1886.eotfSegmented = cmsDupToneCurve(bt1886.eotfFloat);
+    bt1886.oetfSegmented = cmsDupToneCurve(bt1886.oetfFloat);
+
+    auto &pq = curves[index(Curve::PQ)];
+    pq.eotf = buildClippedCurve(ctx, pqEOTF);
+    pq.oetf = buildClippedCurve(ctx, pqInverseEOTF);
+    pq.eotfFloat = cmsDupToneCurve(pq.eotf);
+    pq.oetfFloat = cmsDupToneCurve(pq.oetf);
+    pq.eotfSegmented = buildSampledPQEOTF(ctx);
+    pq.oetfSegmented = buildSampledPQInverseEOTF(ctx);
+
+    auto &hlg = curves[index(Curve::HLG)];
+    hlg.eotf = buildClippedCurve(ctx, hlgInverseOETF);
+    hlg.oetf = buildClippedCurve(ctx, hlgOETF);
+    hlg.eotfFloat = cmsDupToneCurve(hlg.eotf);
+    hlg.oetfFloat = cmsDupToneCurve(hlg.oetf);
+    hlg.eotfSegmented = buildSegmentedHLGInverseOETF(ctx);
+    hlg.oetfSegmented = buildSegmentedHLGOETF(ctx);
+
+    for (const auto display : {Display::SRGB, Display::DisplayP3, Display::BT709}) {
+        displays[static_cast<size_t>(display)] = createDisplayProfile(ctx, display);
+    }
+}
+
+ProfileBuilder::~ProfileBuilder()
+{
+    for (auto *display : displays) {
+        if (display) {
+            cmsCloseProfile(display);
+        }
+    }
+    for (const auto &c : curves) {
+        for (auto *curve : {c.eotf, c.oetf, c.eotfFloat, c.oetfFloat, c.eotfSegmented, c.oetfSegmented}) {
+            if (curve) {
+                cmsFreeToneCurve(curve);
+            }
+        }
+    }
+}
+
+cmsHPROFILE ProfileBuilder::build(const Params &params) const
+{
+    if (params.version == 2 && params.shaper != Shaper::Identity && params.clutPrecision == CLutPrecision::UInt8) {
+        std::cerr << "Cannot create " << profileName(params) << ": the lut8Type cannot hold the fitted shaper" << std::endl;
+        return nullptr;
+    }
+
+    const auto &c = curves[index(params.curve)];
+
+    auto profile = params.version == 2 ? createProfileV2(ctx, shared, c, params, samplerThreads) : createProfileV4(ctx, shared, c, params, samplerThreads);
+    if (!profile) {
+        std::cerr << "Cannot create " << profileName(params) << std::endl;
+        return nullptr;
+    }
+
+    if (params.storage == Storage::Compact) {
+        linkIdenticalTags(profile);
+    }
+
+    if (!cmsMD5computeID(profile)) {
+        std::cerr << "Failed MD5 computation of " << profileName(params) << std::endl;
+        cmsCloseProfile(profile);
+        return nullptr;
+    }
+
+    return profile;
+}
+
+cmsHPROFILE ProfileBuilder::buildLink(cmsHPROFILE yCbCr, const Params &params, const LinkParams &link) const
+{
+    auto display = displays[static_cast<size_t>(link.display)];
+    if (!display) {
+        return nullptr;
+    }
+
+    // Keep the transform at full precision; the device link resamples it
+    // into its own CLUT.
+    auto transform = cmsCreateTransformTHR(ctx, yCbCr, TYPE_YCbCr_16, display, TYPE_RGB_16, INTENT_PERCEPTUAL, cmsFLAGS_NOOPTIMIZE | cmsFLAGS_NOCACHE);
+    if (!transform) {
+        std::cerr << "Cannot create the transform for " << linkName(params, link) << std::endl;
+        return nullptr;
+    }
+    cmsUInt32Number flags = cmsFLAGS_GRIDPOINTS(link.resolution);
+    if (params.clutPrecision == CLutPrecision::UInt8) {
+        flags |= cmsFLAGS_8BITS_DEVICELINK;
+    }
+    auto profile = cmsTransform2DeviceLink(transform, params.version == 2 ? 2.1 : 4.3, flags);
+    cmsDeleteTransform(transform);
+    if (!profile) {
+        std::cerr << "Cannot create the device link " << linkName(params, link) << std::endl;
+        return nullptr;
+    }
+
+    setupMetadata(ctx, profile, linkDescription(params, link), params.storage);
+    if (params.storage == Storage::Compact) {
+        linkIdenticalTags(profile);
+    }
+
+    if (!cmsMD5computeID(profile)) {
+        std::cerr << "Failed MD5 computation of " << linkName(params, link) << std::endl;
+        cmsCloseProfile(profile);
+        return nullptr;
+    }
+
+    return profile;
+}
+
+cmsHPROFILE buildProfile(cmsContext ctx, const Params &params, unsigned int samplerThreads)
+{
+    const auto shared = createSharedData(ctx);
+    const ProfileBuilder builder(ctx, shared, samplerThreads);
+    return builder.build(params);
+}
+
+std::vector<cmsUInt8Number> buildProfileBytes(cmsContext ctx, const Params &params, unsigned int samplerThreads)
+{
+    auto profile = buildProfile(ctx, params, samplerThreads);
+    if (!profile) {
+        return {};
+    }
+    auto bytes = profileBytes(profile);
+    cmsCloseProfile(profile);
+    return bytes;
+}
+} // namespace ycbcr
@@ -0,0 +1,257 @@
+// SPDX-FileCopyrightText: 2022 Amyspark <amy@amyspark.me>
+// SPDX-License-Identifier: BSD-3-Clause
+
+#pragma once
+
+#include <lcms2.h>
+
+#include <array>
+#include <string>
+#include <vector>
+
+#include "ycbcr_coefficients.h"
+
+// LittleCMS has no predefined floating point YCbCr format.
+#ifndef TYPE_YCbCr_FLT
+#define TYPE_YCbCr_FLT (FLOAT_SH(1) | COLORSPACE_SH(PT_YCbCr) | CHANNELS_SH(3) | BYTES_SH(4))
+#endif
+
+namespace ycbcr
+{
+// BT2020 is the non-constant luminance variant.
+enum class Standard { BT601, BT709, BT2020 };
+
+// PQ and HLG are the BT.2100 curves. Their linear light is scaled so that
+// the reference white is 1 (203 cd/m^2 for PQ, the signal 0.75 for HLG), and
+// goes up to about 49 and 3.8 respectively; HLG is scene light, without the
+// OOTF. Their highlights only fit the floating point DToB0/BToD0 tags of the
+// v4 profiles, with Precision::Float. The AToB0/BToA0 tags clip them at the
+// reference white.
+enum class Curve { OETF, BT1886, PQ, HLG };
+
+inline bool isHDR(Curve curve)
+{
+    return curve == Curve::PQ || curve == Curve::HLG;
+}
+
+// Storage of the DToB0/BToD0 pipelines of the v4 profiles.
+enum class Precision { UInt16, Float };
+
+// Quantization range of the YCbCr samples, normalized as n-bit integers
+// over 2^n - 1. Full range maps them to Y' in [0, 1] and Cb, Cr in
+// [-0.5, 0.5] directly; limited range puts black and white at 16 and 235,
+// and the chroma extremes at 16 and 240, times 2^(n - 8), for n = 8 or 10.
+enum class Range { Full, Limited8, Limited10 };
+
+// Curves around the CLUT of the v2 profiles. Fitted warps XYZ with the
+// CIE L* function: on the input of BToA0, and, since YCbCr is already
+// perceptually coded, on the output of AToB0 (through its inverse), so
+// that the CLUT holds a nearly linear map and needs fewer points.
+enum class Shaper { Identity, Fitted };
+
+// How much the profiles spend on anything but accuracy. Compact shortens
+// the copyright, leaves out the optional device descriptions, stores the
+// DToB0/BToD0 curves as formula segments instead of samples wherever they
+// can be, and links tags whose contents are identical, so that they're
+// stored once.
+enum class Storage { Full, Compact };
+
+// Sample size of the AToB0/BToA0 CLUTs, and of the device links' CLUTs. v2
+// profiles with UInt8 are stored as lut8Type, whose curves are 8-bit too,
+// with exactly 256 entries: they cannot hold the fitted shaper.
+enum class CLutPrecision { UInt16, UInt8 };
+
+constexpr cmsUInt32Number defaultResolution = 24;
+
+// Number of samples used to tabulate the curves that cannot be stored
+// parametrically (the BT.601/709 OETF and its inverse).
+constexpr size_t curveSamples = 1024;
+
+struct Params {
+    Standard standard = Standard::BT709;
+    Curve curve = Curve::OETF;
+    // ICC major version, either 2 or 4.
+    int version = 4;
+    // Number of CLUT grid points per dimension. CLUTs that only hold an
+    // affine map get the 2 that are enough, see clutResolution().
+    cmsUInt32Number resolution = defaultResolution;
+    // With Float, the DToB0/BToD0 tags pack the YCbCr <-> R'G'B' step into a
+    // floating point CLUT sampled without 16-bit quantization, and use
+    // exact segmented curves instead of sampled ones. v4 only.
+    Precision precision = Precision::UInt16;
+    // Folded into the YCbCr offset stage of every pipeline.
+    Range range = Range::Full;
+    // v2 only.
+    Shaper shaper = Shaper::Identity;
+    Storage storage = Storage::Full;
+    CLutPrecision clutPrecision = CLutPrecision::UInt16;
+};
+
+// RGB displays the device links convert to.
+enum class Display { SRGB, DisplayP3, BT709 };
+
+// Number of CLUT grid points per dimension of the device links. Same as
+// LittleCMS' own for 16-bit RGB transforms.
+constexpr cmsUInt32Number defaultLinkResolution = 33;
+
+// A device link from a YCbCr profile to a display.
+struct LinkParams {
+    Display display = Display::SRGB;
+    cmsUInt32Number resolution = defaultLinkResolution;
+};
+
+// 3D LUTs of the YCbCr <-> R'G'B' conversion, for tools that don't take
+// ICC profiles.
+enum class LutFormat { Cube, CLF };
+
+enum class LutDirection { YCbCrToRGB, RGBToYCbCr };
+
+constexpr cmsUInt32Number defaultLutSize = 65;
+
+struct LutParams {
+    LutFormat format = LutFormat::Cube;
+    LutDirection direction = LutDirection::YCbCrToRGB;
+    // Number of grid points per dimension.
+    cmsUInt32Number size = defaultLutSize;
+};
+
+// Data that doesn't depend on the variant being built. It's computed once
+// and then handed to every worker, regardless of its context.
+struct SharedData {
+    // Bradford transform from D65 (BT.601-7, BT.709-6) to D50 (ICC 4.3)
+    // Source: Elle Stone's well behaved sRGB profile
+    // Thanks to Doug Walker from ILM for pointing it out.
+    std::array<cmsFloat64Number, 3 * 3> chromaticAdaptation;
+    // The Rec.601/709 parametric curves, sampled.
+    std::array<cmsFloat32Number, curveSamples> eotfSamples;
+    std::array<cmsFloat32Number, curveSamples> oetfSamples;
+};
+
+inline const Coefficients &coefficients(Standard standard)
+{
+    switch (standard) {
+    case Standard::BT601:
+        return bt601;
+    case Standard::BT2020:
+        return bt2020;
+    default:
+        return bt709;
+    }
+}
+
+// The affine map from the normalized YCbCr samples to Y' in [0, 1] and Cb,
+// Cr in [-0.5, 0.5]: centered = scale * ycbcr + offset.
+struct RangeMapping {
+    std::array<double, 3> scale;
+    std::array<double, 3> offset;
+};
+
+inline RangeMapping rangeMapping(Range range)
+{
+    if (range == Range::Full) {
+        return {{1, 1, 1}, offset_ycbcr_to_rgb};
+    }
+    const double k = range == Range::Limited8 ? 1 : 4;
+    const double maximum = 256 * k - 1;
+    const double luma = maximum / ((limitedWhite - limitedBlack) * k);
+    const double chroma = maximum / (limitedChromaExcursion * k);
+    return {{luma, chroma, chroma},
+            {-limitedBlack / (limitedWhite - limitedBlack), -limitedAchromatic / limitedChromaExcursion, -limitedAchromatic / limitedChromaExcursion}};
+}
+
+// The profile's file name, e.g. bt709-6_bt1886_ycbcr_v4.icc,
+// bt709-6_ycbcr_v4_limited10.icc, bt709-6_ycbcr_v2_shaper_17.icc,
+// bt709-6_ycbcr_v4_compact_clut8.icc or bt2020-2_pq_ycbcr_v4_float.icc.
+std::string profileName(const Params &params);
+
+// The profile's description, e.g. ITU-R BT.709-6 YCbCr ICC V4 profile.
+std::string profileDescription(const Params &params);
+
+// The device link's file name, e.g. bt709-6_ycbcr_v4_to_srgb.icc.
+std::string linkName(const Params &params, const LinkParams &link);
+
+// The device link's description, e.g. ITU-R BT.709-6 YCbCr to sRGB ICC V4
+// device link.
+std::string linkDescription(const Params &params, const LinkParams &link);
+
+// The 3D LUT's file name, e.g. bt709-6_limited10_ycbcr_to_rgb_65.cube. It
+// only depends on the standard and the range, as the R'G'B' side doesn't
+// go through the curves.
+std::string lutName(const Params &params, const LutParams &lut);
+
+// The 3D LUT's title, e.g. ITU-R BT.709-6 YCbCr to R'G'B'.
+std::string lutDescription(const Params &params, const LutParams &lut);
+
+// The RGB profile the YCbCr profiles are derived from: BT.709 primaries
+// and white point, with the given curves.
+cmsHPROFILE createBaseRec709Profile(cmsContext ctx, cmsToneCurve *toneCurveInv);
+
+// The display's name in file and device link names: srgb, p3 or bt709.
+const char *displayFileName(Display display);
+
+// The display's RGB profile, or nullptr on failure.
+cmsHPROFILE createDisplayProfile(cmsContext ctx, Display display);
+
+SharedData createSharedData(cmsContext ctx);
+
+// The serialized profile, or an empty vector on failure.
+std::vector<cmsUInt8Number> profileBytes(cmsHPROFILE profile);
+
+// The parametric and tabulated curves of a transfer characteristic,
+// allocated in a single context. Each worker builds one set and reuses it
+// for every variant it generates.
+struct TransferCurves {
+    // Normalized R'G'B -> linear RGB, as in the base RGB profile.
+    cmsToneCurve *eotf = nullptr;
+    // Linear RGB -> normalized R'G'B.
+    cmsToneCurve *oetf = nullptr;
+    // Same as above, in a shape storable in the DToB0/BToD0 tags.
+    cmsToneCurve *eotfFloat = nullptr;
+    cmsToneCurve *oetfFloat = nullptr;
+    // Same as above, without sampling, for Precision::Float. The PQ curves
+    // are sampled finely enough instead, and, unlike the above, aren't
+    // clipped at the reference white.
+    cmsToneCurve *eotfSegmented = nullptr;
+    cmsToneCurve *oetfSegmented = nullptr;
+};
+
+class ProfileBuilder
+{
+public:
+    // samplerThreads is the number of threads used to sample each CLUT.
+    ProfileBuilder(cmsContext ctx, const SharedData &shared, unsigned int samplerThreads = 1);
+    ~ProfileBuilder();
+
+    ProfileBuilder(const ProfileBuilder &) = delete;
+    ProfileBuilder &operator=(const ProfileBuilder &) = delete;
+
+    // Returns a profile with its MD5 already computed, or nullptr on failure.
+    cmsHPROFILE build(const Params &params) const;
+
+    // Returns a device link from yCbCr, built from params, to the display,
+    // or nullptr on failure. Its version follows the YCbCr profile's, and
+    // its MD5 is already computed.
+    cmsHPROFILE buildLink(cmsHPROFILE yCbCr, const Params &params, const LinkParams &link) const;
+
+private:
+    cmsContext ctx;
+    const SharedData &shared;
+    unsigned int samplerThreads;
+    // Indexed by Curve.
+    std::array<TransferCurves, 4> curves;
+    // The device link destinations, indexed by Display.
+    std::array<cmsHPROFILE, 3> displays{};
+};
+
+// One-shot versions of ProfileBuilder::build, for applications that build
+// profiles on demand instead of shipping the generated ones.
+//
+// Everything is allocated in ctx, and everything but the returned profile
+// is freed before returning; no global lcms state is touched, and lcms
+// errors go through ctx's log handler. Any number of threads can build profiles
+// at the same time, each with its own context. Returns nullptr (or an
+// empty vector) on failure.
+cmsHPROFILE buildProfile(cmsContext ctx, const Params &params, unsigned int samplerThreads = 1);
+
+std::vector<cmsUInt8Number> buildProfileBytes(cmsContext ctx, const Params &params, unsigned int samplerThreads = 1);
+} // namespace ycbcr
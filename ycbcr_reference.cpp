@@ -0,0 +1,110 @@
+// SPDX-FileCopyrightText: 2022 Amyspark <amy@amyspark.me>
+// SPDX-License-Identifier: BSD-3-Clause
+
+#include "ycbcr_reference.h"
+
+#include <cmath>
+
+#include "ycbcr_hdr.h"
+
+namespace ycbcr
+{
+namespace
+{
+Triplet multiply(const std::array<double, 3 * 3> &m, const Triplet &v)
+{
+    Triplet r{};
+    for (size_t i = 0; i < 3; i++) {
+        r[i] = m[i * 3] * v[0] + m[i * 3 + 1] * v[1] + m[i * 3 + 2] * v[2];
+    }
+    return r;
+}
+} // namespace
+
+cmsFloat64Number eotf(Curve curve, cmsFloat64Number v)
+{
+    if (curve == Curve::PQ) {
+        return pqEOTF(v);
+    }
+    if (curve == Curve::HLG) {
+        return hlgInverseOETF(v);
+    }
+    if (curve == Curve::BT1886) {
+        return v <= 0 ? 0 : std::pow(v, bt1886Gamma);
+    }
+    // Same shape as the type 4 parametric curve of rec709ParametersInv.
+    const auto &p = rec709ParametersInv;
+    return v >= p[4] ? std::pow(p[1] * v + p[2], p[0]) : p[3] * v;
+}
+
+cmsFloat64Number oetf(Curve curve, cmsFloat64Number l)
+{
+    if (curve == Curve::PQ) {
+        return pqInverseEOTF(l);
+    }
+    if (curve == Curve::HLG) {
+        return hlgOETF(l);
+    }
+    if (curve == Curve::BT1886) {
+        return l <= 0 ? 0 : std::pow(l, 1.0 / bt1886Gamma);
+    }
+    // BT.709-6 ss. 1.2, same shape as the type 5 parametric curve of
+    // rec709Parameters.
+    const auto &p = rec709Parameters;
+    return l >= p[4] ? std::pow(p[1] * l + p[2], p[0]) + p[5] : p[3] * l + p[6];
+}
+
+Triplet rgbToYCbCr(const Params &params, const Triplet &rgb)
+{
+    const auto mapping = rangeMapping(params.range);
+    auto ycbcr = multiply(coefficients(params.standard).rgb_to_ycbcr, rgb);
+    for (size_t i = 0; i < 3; i++) {
+        ycbcr[i] = (ycbcr[i] - mapping.offset[i]) / mapping.scale[i];
+    }
+    return ycbcr;
+}
+
+Triplet yCbCrToRGB(const Params &params, const Triplet &ycbcr)
+{
+    const auto mapping = rangeMapping(params.range);
+    Triplet centered{};
+    for (size_t i = 0; i < 3; i++) {
+        centered[i] = mapping.scale[i] * ycbcr[i] + mapping.offset[i];
+    }
+    return multiply(coefficients(params.standard).ycbcr_to_rgb, centered);
+}
+
+Triplet yCbCrToXYZ(const Params &params, const Triplet &ycbcr)
+{
+    auto rgb = yCbCrToRGB(params, ycbcr);
+    for (auto &v : rgb) {
+        v = eotf(params.curve, v);
+    }
+    return multiply(coefficients(params.standard).rgb_to_xyz, rgb);
+}
+
+Triplet xyzToYCbCr(const Params &params, const Triplet &xyz)
+{
+    auto rgb = multiply(coefficients(params.standard).xyz_to_rgb, xyz);
+    for (auto &v : rgb) {
+        v = oetf(params.curve, v);
+    }
+    return rgbToYCbCr(params, rgb);
+}
+
+cmsCIEXYZ whitePoint(const Params &params)
+{
+    const auto white = multiply(coefficients(params.standard).rgb_to_xyz, {1, 1, 1});
+    return {white[0], white[1], white[2]};
+}
+
+cmsFloat64Number deltaE(const cmsCIEXYZ &white, const Triplet &a, const Triplet &b)
+{
+    const cmsCIEXYZ xyzA{a[0], a[1], a[2]};
+    const cmsCIEXYZ xyzB{b[0], b[1], b[2]};
+    cmsCIELab labA, labB;
+    cmsXYZ2Lab(&white, &labA, &xyzA);
+    cmsXYZ2Lab(&white, &labB, &xyzB);
+    return cmsCIE2000DeltaE(&labA, &labB, 1, 1, 1);
+}
+} // namespace ycbcr
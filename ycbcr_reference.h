@@ -0,0 +1,46 @@
+// SPDX-FileCopyrightText: 2022 Amyspark <amy@amyspark.me>
+// SPDX-License-Identifier: BSD-3-Clause
+
+#pragma once
+
+#include <lcms2.h>
+
+#include <array>
+
+#include "ycbcr_profile.h"
+
+namespace ycbcr
+{
+using Triplet = std::array<cmsFloat64Number, 3>;
+
+// The conversions the profiles encode, evaluated analytically in double
+// precision: no CLUTs, no sampled curves, no clamping. YCbCr is in the
+// profile's range, with the chroma channels offset to [0, 1] when full range,
+// and XYZ is scaled so that Y = 1 is the reference white, as in the profile
+// pipelines.
+
+// Normalized R'G'B -> linear RGB.
+cmsFloat64Number eotf(Curve curve, cmsFloat64Number v);
+
+// Linear RGB -> normalized R'G'B.
+cmsFloat64Number oetf(Curve curve, cmsFloat64Number l);
+
+// Normalized R'G'B -> YCbCr.
+Triplet rgbToYCbCr(const Params &params, const Triplet &rgb);
+
+// YCbCr -> normalized R'G'B'.
+Triplet yCbCrToRGB(const Params &params, const Triplet &ycbcr);
+
+// YCbCr -> XYZ, i.e. the DToB0 pipeline.
+Triplet yCbCrToXYZ(const Params &params, const Triplet &ycbcr);
+
+// XYZ -> YCbCr, i.e. the BToD0 pipeline.
+Triplet xyzToYCbCr(const Params &params, const Triplet &xyz);
+
+// The XYZ of the reference white (linear RGB = 1, 1, 1), which for the SDR
+// curves is also R'G'B' = 1, 1, 1.
+cmsCIEXYZ whitePoint(const Params &params);
+
+// CIEDE2000 between two XYZ colors, relative to the profile's white.
+cmsFloat64Number deltaE(const cmsCIEXYZ &white, const Triplet &a, const Triplet &b);
+} // namespace ycbcr
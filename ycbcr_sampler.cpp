@@ -0,0 +1,372 @@
+// SPDX-FileCopyrightText: 2022 Amyspark <amy@amyspark.me>
+// SPDX-License-Identifier: BSD-3-Clause
+
+#include "ycbcr_sampler.h"
+
+#include <lcms2_plugin.h>
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+namespace ycbcr
+{
+namespace
+{
+struct Grid {
+    cmsUInt32Number nInputs;
+    cmsUInt32Number nOutputs;
+    std::array<cmsUInt32Number, MAX_INPUT_DIMENSIONS> nSamples;
+    cmsUInt32Number nTotalPoints;
+    // Number of nodes in a plane spanned by the two fastest varying inputs.
+    cmsUInt32Number planeSize;
+};
+
+// Runs a batch of grid nodes through the pipeline one stage at a time,
+// instead of one node at a time through the whole pipeline. The values
+// in between stages are kept as one array per channel, so that the matrix
+// stages become tight loops over the batch.
+//
+// The arithmetic mirrors lcms' own stage evaluators (float storage between
+// stages, double accumulation in the matrices), so the results are
+// bit-identical to cmsPipelineEval16.
+class BatchEvaluator
+{
+public:
+    BatchEvaluator(const cmsPipeline *lut, size_t capacity)
+        : capacity(capacity)
+    {
+        size_t maxChannels = cmsPipelineInputChannels(lut);
+        for (auto mpe = cmsPipelineGetPtrToFirstStage(lut); mpe; mpe = cmsStageNext(mpe)) {
+            const auto type = cmsStageType(mpe);
+            if (type != cmsSigMatrixElemType && type != cmsSigCurveSetElemType) {
+                stages.clear();
+                supported = false;
+                return;
+            }
+            stages.push_back({type, cmsStageInputChannels(mpe), cmsStageOutputChannels(mpe), cmsStageData(mpe)});
+            maxChannels = std::max<size_t>(maxChannels, cmsStageOutputChannels(mpe));
+        }
+        for (auto &buffer : buffers) {
+            buffer.resize(maxChannels * capacity);
+        }
+        accumulator.resize(capacity);
+    }
+
+    bool isSupported() const
+    {
+        return supported;
+    }
+
+    // The first `count` values of each input channel.
+    cmsFloat32Number *input(cmsUInt32Number channel)
+    {
+        return buffers[0].data() + channel * capacity;
+    }
+
+    // Evaluates `count` nodes. Output channel i of node k is at
+    // result[i * capacity + k].
+    const cmsFloat32Number *eval(size_t count)
+    {
+        size_t phase = 0;
+        for (const auto &stage : stages) {
+            const auto *in = buffers[phase].data();
+            auto *out = buffers[phase ^ 1].data();
+            if (stage.type == cmsSigMatrixElemType) {
+                evalMatrix(stage, count, in, out);
+            } else {
+                evalCurves(stage, count, in, out);
+            }
+            phase ^= 1;
+        }
+        return buffers[phase].data();
+    }
+
+    size_t stride() const
+    {
+        return capacity;
+    }
+
+private:
+    struct Stage {
+        cmsStageSignature type;
+        cmsUInt32Number nInputs;
+        cmsUInt32Number nOutputs;
+        const void *data;
+    };
+
+    void evalMatrix(const Stage &stage, size_t count, const cmsFloat32Number *in, cmsFloat32Number *out)
+    {
+        const auto *data = reinterpret_cast<const _cmsStageMatrixData *>(stage.data);
+        auto *acc = accumulator.data();
+        for (cmsUInt32Number i = 0; i < stage.nOutputs; i++) {
+            std::fill_n(acc, count, 0.0);
+            for (cmsUInt32Number j = 0; j < stage.nInputs; j++) {
+                const auto *src = in + j * capacity;
+                const auto m = data->Double[i * stage.nInputs + j];
+                for (size_t k = 0; k < count; k++) {
+                    acc[k] += src[k] * m;
+                }
+            }
+            const auto offset = data->Offset ? data->Offset[i] : 0.0;
+            auto *dst = out + i * capacity;
+            if (data->Offset) {
+                for (size_t k = 0; k < count; k++) {
+                    dst[k] = static_cast<cmsFloat32Number>(acc[k] + offset);
+                }
+            } else {
+                for (size_t k = 0; k < count; k++) {
+                    dst[k] = static_cast<cmsFloat32Number>(acc[k]);
+                }
+            }
+        }
+    }
+
+    void evalCurves(const Stage &stage, size_t count, const cmsFloat32Number *in, cmsFloat32Number *out) const
+    {
+        const auto *data = reinterpret_cast<const _cmsStageToneCurvesData *>(stage.data);
+        for (cmsUInt32Number i = 0; i < data->nCurves; i++) {
+            const auto *curve = data->TheCurves[i];
+            const auto *src = in + i * capacity;
+            auto *dst = out + i * capacity;
+            for (size_t k = 0; k < count; k++) {
+                dst[k] = cmsEvalToneCurveFloat(curve, src[k]);
+            }
+        }
+    }
+
+    size_t capacity;
+    bool supported = true;
+    std::vector<Stage> stages;
+    std::array<std::vector<cmsFloat32Number>, 2> buffers;
+    std::vector<cmsFloat64Number> accumulator;
+};
+
+// Computes the grid coordinates of node i. The node numbering (and thus
+// the table layout) is the same as cmsStageSampleCLut16bit's: the last
+// input channel varies the fastest.
+void nodeInputs(const Grid &grid, cmsUInt32Number i, cmsUInt16Number In[])
+{
+    auto rest = i;
+    for (auto t = static_cast<cmsInt32Number>(grid.nInputs) - 1; t >= 0; --t) {
+        const auto colorant = rest % grid.nSamples[t];
+        rest /= grid.nSamples[t];
+        In[t] = _cmsQuantizeVal(colorant, grid.nSamples[t]);
+    }
+}
+
+// How cmsStageSampleCLut16bit and cmsStageSampleCLutFloat feed the nodes to
+// the pipeline and store its output, for each kind of table.
+template<typename T>
+struct Sampling;
+
+template<>
+struct Sampling<cmsUInt16Number> {
+    // The batch equivalent of cmsPipelineEval16's From16ToFloat.
+    static cmsFloat32Number input(cmsUInt16Number v)
+    {
+        return static_cast<cmsFloat32Number>(v) / 65535.0F;
+    }
+
+    // The batch equivalent of cmsPipelineEval16's FromFloatTo16.
+    static cmsUInt16Number output(cmsFloat32Number v)
+    {
+        return _cmsQuickSaturateWord(v * 65535.0);
+    }
+
+    static void eval(const cmsUInt16Number In[], cmsUInt16Number Out[], const cmsPipeline *lut)
+    {
+        cmsPipelineEval16(In, Out, lut);
+    }
+};
+
+template<>
+struct Sampling<cmsFloat32Number> {
+    static cmsFloat32Number input(cmsUInt16Number v)
+    {
+        return static_cast<cmsFloat32Number>(v / 65535.0);
+    }
+
+    static cmsFloat32Number output(cmsFloat32Number v)
+    {
+        return v;
+    }
+
+    static void eval(const cmsUInt16Number In[], cmsFloat32Number Out[], const cmsPipeline *lut)
+    {
+        std::array<cmsFloat32Number, MAX_INPUT_DIMENSIONS + 1> InFloat{};
+        for (size_t t = 0; t < InFloat.size(); t++) {
+            InFloat[t] = input(In[t]);
+        }
+        cmsPipelineEvalFloat(InFloat.data(), Out, lut);
+    }
+};
+
+// Evaluates the nodes [begin, end) of the grid, a plane at a time if the
+// pipeline can be batched, or node by node otherwise.
+template<typename T>
+bool sampleRange(T *table, const Grid &grid, const cmsPipeline *pipeline, cmsUInt32Number begin, cmsUInt32Number end)
+{
+    auto lut = cmsPipelineDup(pipeline);
+    if (!lut) {
+        return false;
+    }
+
+    std::array<cmsUInt16Number, MAX_INPUT_DIMENSIONS + 1> In{};
+    BatchEvaluator evaluator(lut, grid.planeSize);
+    if (evaluator.isSupported()) {
+        for (auto block = begin; block < end; block += grid.planeSize) {
+            const auto count = std::min(grid.planeSize, end - block);
+            for (cmsUInt32Number k = 0; k < count; k++) {
+                nodeInputs(grid, block + k, In.data());
+                for (cmsUInt32Number t = 0; t < grid.nInputs; t++) {
+                    evaluator.input(t)[k] = Sampling<T>::input(In[t]);
+                }
+            }
+            const auto *result = evaluator.eval(count);
+            auto *Out = table + static_cast<size_t>(block) * grid.nOutputs;
+            for (size_t k = 0; k < count; k++) {
+                for (cmsUInt32Number i = 0; i < grid.nOutputs; i++) {
+                    Out[k * grid.nOutputs + i] = Sampling<T>::output(result[i * evaluator.stride() + k]);
+                }
+            }
+        }
+    } else {
+        for (auto i = begin; i < end; i++) {
+            nodeInputs(grid, i, In.data());
+            Sampling<T>::eval(In.data(), table + static_cast<size_t>(i) * grid.nOutputs, lut);
+        }
+    }
+
+    cmsPipelineFree(lut);
+    return true;
+}
+
+// Checks that the CLUT and pipeline match, and describes the CLUT's grid.
+bool describeGrid(const _cmsStageCLutData *data, const cmsPipeline *pipeline, Grid &grid)
+{
+    grid.nInputs = data->Params->nInputs;
+    grid.nOutputs = data->Params->nOutputs;
+    if (grid.nInputs > MAX_INPUT_DIMENSIONS || grid.nInputs != cmsPipelineInputChannels(pipeline)
+        || grid.nOutputs != cmsPipelineOutputChannels(pipeline)) {
+        std::cerr << "Mismatched CLUT and pipeline channels" << std::endl;
+        return false;
+    }
+    grid.nTotalPoints = 1;
+    for (cmsUInt32Number t = 0; t < grid.nInputs; t++) {
+        grid.nSamples[t] = data->Params->nSamples[t];
+        grid.nTotalPoints *= grid.nSamples[t];
+    }
+    grid.planeSize = grid.nSamples[grid.nInputs - 1];
+    if (grid.nInputs > 1) {
+        grid.planeSize *= grid.nSamples[grid.nInputs - 2];
+    }
+    return true;
+}
+
+template<typename T>
+bool sampleGrid(T *table, const Grid &grid, const cmsPipeline *pipeline, unsigned int threads)
+{
+    threads = std::max(1U, std::min(threads, grid.nTotalPoints));
+    if (threads == 1) {
+        return sampleRange(table, grid, pipeline, 0, grid.nTotalPoints);
+    }
+
+    std::atomic<bool> ok{true};
+    std::vector<std::thread> workers;
+    const auto chunk = (grid.nTotalPoints + threads - 1) / threads;
+    for (cmsUInt32Number begin = 0; begin < grid.nTotalPoints; begin += chunk) {
+        const auto end = std::min(begin + chunk, grid.nTotalPoints);
+        workers.emplace_back([&, begin, end]() {
+            if (!sampleRange(table, grid, pipeline, begin, end)) {
+                ok = false;
+            }
+        });
+    }
+    for (auto &t : workers) {
+        t.join();
+    }
+
+    return ok;
+}
+} // namespace
+
+bool sampleCLut16bit(cmsStage *clut, const cmsPipeline *pipeline, unsigned int threads)
+{
+    if (!clut || !pipeline || cmsStageType(clut) != cmsSigCLutElemType) {
+        return false;
+    }
+
+    auto data = reinterpret_cast<_cmsStageCLutData *>(cmsStageData(clut));
+    if (data->HasFloatValues || !data->Tab.T) {
+        std::cerr << "Cannot sample a floating point CLUT as 16-bit" << std::endl;
+        return false;
+    }
+
+    Grid grid{};
+    if (!describeGrid(data, pipeline, grid)) {
+        return false;
+    }
+
+    return sampleGrid(data->Tab.T, grid, pipeline, threads);
+}
+
+bool sampleCLutFloat(cmsStage *clut, const cmsPipeline *pipeline, unsigned int threads)
+{
+    if (!clut || !pipeline || cmsStageType(clut) != cmsSigCLutElemType) {
+        return false;
+    }
+
+    auto data = reinterpret_cast<_cmsStageCLutData *>(cmsStageData(clut));
+    if (!data->HasFloatValues || !data->Tab.TFloat) {
+        std::cerr << "Cannot sample a 16-bit CLUT as floating point" << std::endl;
+        return false;
+    }
+
+    Grid grid{};
+    if (!describeGrid(data, pipeline, grid)) {
+        return false;
+    }
+
+    return sampleGrid(data->Tab.TFloat, grid, pipeline, threads);
+}
+
+cmsUInt32Number clutResolution(const cmsPipeline *pipeline, cmsUInt32Number resolution, bool clamped)
+{
+    const auto nInputs = cmsPipelineInputChannels(pipeline);
+    const auto nOutputs = cmsPipelineOutputChannels(pipeline);
+    if (resolution <= 2 || nInputs > MAX_INPUT_DIMENSIONS || nOutputs > cmsMAXCHANNELS) {
+        return resolution;
+    }
+    for (auto mpe = cmsPipelineGetPtrToFirstStage(pipeline); mpe; mpe = cmsStageNext(mpe)) {
+        if (cmsStageType(mpe) != cmsSigMatrixElemType) {
+            return resolution;
+        }
+    }
+    if (!clamped) {
+        return 2;
+    }
+
+    // The image of the cube is the convex hull of the images of its corners,
+    // so it's enough to check these. Values that round to 0 or 65535 are
+    // stored as they would be on the full grid.
+    constexpr cmsFloat32Number tolerance = 0.5f / 65535.0f;
+    std::array<cmsFloat32Number, MAX_INPUT_DIMENSIONS> in{};
+    std::array<cmsFloat32Number, cmsMAXCHANNELS> out{};
+    for (cmsUInt32Number corner = 0; corner < (1U << nInputs); corner++) {
+        for (cmsUInt32Number i = 0; i < nInputs; i++) {
+            in[i] = static_cast<cmsFloat32Number>((corner >> i) & 1);
+        }
+        cmsPipelineEvalFloat(in.data(), out.data(), pipeline);
+        for (cmsUInt32Number i = 0; i < nOutputs; i++) {
+            if (out[i] < -tolerance || out[i] > 1 + tolerance) {
+                return resolution;
+            }
+        }
+    }
+    return 2;
+}
+} // namespace ycbcr
@@ -0,0 +1,33 @@
+// SPDX-FileCopyrightText: 2022 Amyspark <amy@amyspark.me>
+// SPDX-License-Identifier: BSD-3-Clause
+
+#pragma once
+
+#include <lcms2.h>
+
+namespace ycbcr
+{
+// Fills the 16-bit CLUT stage `clut` with the output of `pipeline` at each
+// grid node, exactly as cmsStageSampleCLut16bit + cmsPipelineEval16 would.
+//
+// The grid is split in contiguous ranges of nodes, one per thread; each
+// thread evaluates its own copy of the pipeline and writes straight into
+// the CLUT table. Pipelines made only of matrices and curves are evaluated
+// a plane of nodes at a time. The result is bit-identical to the serial
+// path regardless of the number of threads.
+bool sampleCLut16bit(cmsStage *clut, const cmsPipeline *pipeline, unsigned int threads);
+
+// Same as above for a floating point CLUT stage, exactly as
+// cmsStageSampleCLutFloat + cmsPipelineEvalFloat would. The nodes are
+// stored as they come out of the pipeline, without quantization or
+// clamping.
+bool sampleCLutFloat(cmsStage *clut, const cmsPipeline *pipeline, unsigned int threads);
+
+// Number of grid points per dimension a CLUT needs to hold the pipeline.
+//
+// Linear interpolation, trilinear or tetrahedral, is exact for affine maps
+// on a grid of 2 points per dimension. So if the pipeline is made only of
+// matrices, and, for a 16-bit CLUT (clamped), maps the unit cube within
+// [0, 1], this is 2. Otherwise it's the given resolution.
+cmsUInt32Number clutResolution(const cmsPipeline *pipeline, cmsUInt32Number resolution, bool clamped);
+} // namespace ycbcr
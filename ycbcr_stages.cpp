@@ -0,0 +1,255 @@
+// SPDX-FileCopyrightText: 2022 Amyspark <amy@amyspark.me>
+// SPDX-License-Identifier: BSD-3-Clause
+
+#include "ycbcr_stages.h"
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <utility>
+
+#include "ycbcr_reference.h"
+
+namespace ycbcr
+{
+namespace
+{
+// Colors evaluated per stage, and per timing pass.
+constexpr size_t batchSize = 65536;
+
+// Minimum time spent evaluating each stage.
+constexpr std::chrono::milliseconds minimumDuration{50};
+
+// A stage output is in a space if its channels are within this of the
+// analytic values for at least a quarter of the batch. Loose enough for
+// the clipped highlights of the HDR curves, tight enough to tell the
+// spaces apart.
+constexpr cmsFloat64Number spaceTolerance = 0.01;
+constexpr size_t spaceMinimumMatches = batchSize / 4;
+
+constexpr cmsFloat64Number codeValues = 65535;
+
+enum class Space { YCbCr, CenteredYCbCr, RGBPrime, RGB, XYZ, Unknown };
+
+constexpr std::array<Space, 5> knownSpaces = {Space::YCbCr, Space::CenteredYCbCr, Space::RGBPrime, Space::RGB, Space::XYZ};
+
+const char *spaceName(Space space)
+{
+    switch (space) {
+    case Space::YCbCr:
+        return "ycbcr";
+    case Space::CenteredYCbCr:
+        return "ycbcr_centered";
+    case Space::RGBPrime:
+        return "rgb_prime";
+    case Space::RGB:
+        return "rgb";
+    case Space::XYZ:
+        return "xyz";
+    default:
+        return "?";
+    }
+}
+
+using Batch = std::vector<cmsFloat32Number>;
+
+// The analytic batch in every known space, indexed by Space.
+using AnalyticBatches = std::array<Batch, 5>;
+
+AnalyticBatches analyticBatches(const Params &params)
+{
+    AnalyticBatches batches;
+    for (auto &batch : batches) {
+        batch.reserve(batchSize * 3);
+    }
+    const auto mapping = rangeMapping(params.range);
+    // A deterministic spread of in-gamut R'G'B' colors.
+    cmsUInt32Number seed = 0x12345678;
+    const auto next = [&]() {
+        seed = seed * 1664525U + 1013904223U;
+        return static_cast<cmsFloat64Number>(seed >> 8) / static_cast<cmsFloat64Number>(1U << 24);
+    };
+    for (size_t i = 0; i < batchSize; i++) {
+        const Triplet rgbPrime = {next(), next(), next()};
+        const auto ycbcr = rgbToYCbCr(params, rgbPrime);
+        const auto xyz = yCbCrToXYZ(params, ycbcr);
+        for (size_t c = 0; c < 3; c++) {
+            batches[static_cast<size_t>(Space::YCbCr)].push_back(static_cast<cmsFloat32Number>(ycbcr[c]));
+            batches[static_cast<size_t>(Space::CenteredYCbCr)].push_back(static_cast<cmsFloat32Number>(mapping.scale[c] * ycbcr[c] + mapping.offset[c]));
+            batches[static_cast<size_t>(Space::RGBPrime)].push_back(static_cast<cmsFloat32Number>(rgbPrime[c]));
+            batches[static_cast<size_t>(Space::RGB)].push_back(static_cast<cmsFloat32Number>(eotf(params.curve, rgbPrime[c])));
+            batches[static_cast<size_t>(Space::XYZ)].push_back(static_cast<cmsFloat32Number>(xyz[c]));
+        }
+    }
+    return batches;
+}
+
+void evaluate(const cmsPipeline *lut, const Batch &input, Batch &output)
+{
+    output.resize(input.size());
+    for (size_t i = 0; i < input.size(); i += 3) {
+        cmsPipelineEvalFloat(&input[i], &output[i], lut);
+    }
+}
+
+cmsFloat64Number nsPerPixel(const cmsPipeline *lut, const Batch &input, Batch &output)
+{
+    using clock = std::chrono::steady_clock;
+
+    size_t passes = 0;
+    const auto start = clock::now();
+    auto elapsed = clock::duration::zero();
+    do {
+        evaluate(lut, input, output);
+        passes++;
+        elapsed = clock::now() - start;
+    } while (elapsed < minimumDuration);
+
+    return std::chrono::duration<cmsFloat64Number, std::nano>(elapsed).count() / static_cast<cmsFloat64Number>(passes * batchSize);
+}
+
+size_t matches(const Batch &output, const Batch &analytic)
+{
+    size_t count = 0;
+    for (size_t i = 0; i < output.size(); i += 3) {
+        bool match = true;
+        for (size_t c = 0; c < 3; c++) {
+            const auto difference = static_cast<cmsFloat64Number>(output[i + c]) - analytic[i + c];
+            match = match && std::max(difference, -difference) < spaceTolerance;
+        }
+        count += match ? 1 : 0;
+    }
+    return count;
+}
+
+// The known space the output is closest to, if close enough to any.
+Space identifySpace(const Batch &output, const AnalyticBatches &analytic)
+{
+    auto best = Space::Unknown;
+    size_t bestMatches = spaceMinimumMatches;
+    for (const auto space : knownSpaces) {
+        const auto n = matches(output, analytic[static_cast<size_t>(space)]);
+        if (n >= bestMatches) {
+            best = space;
+            bestMatches = n;
+        }
+    }
+    return best;
+}
+
+std::string signatureName(cmsUInt32Number signature)
+{
+    std::string name;
+    for (int shift = 24; shift >= 0; shift -= 8) {
+        const auto c = static_cast<char>((signature >> shift) & 0xFF);
+        if (c != ' ') {
+            name += c;
+        }
+    }
+    return name;
+}
+
+bool profileTag(cmsContext ctx,
+                cmsHPROFILE profile,
+                cmsTagSignature sig,
+                Space inputSpace,
+                const AnalyticBatches &analytic,
+                std::vector<StageReport> &stages)
+{
+    const auto *lut = reinterpret_cast<const cmsPipeline *>(cmsReadTag(profile, sig));
+    if (!lut) {
+        // v2 profiles have no DToB0/BToD0 tags.
+        return true;
+    }
+
+    auto space = inputSpace;
+    // The input of each stage: the analytic colors when their space is
+    // known, the output of the previous stage otherwise.
+    auto input = analytic[static_cast<size_t>(space)];
+    Batch output;
+    size_t index = 0;
+    for (auto *stage = cmsPipelineGetPtrToFirstStage(lut); stage; stage = cmsStageNext(stage), index++) {
+        // Evaluate the stage alone.
+        auto single = cmsPipelineAlloc(ctx, cmsStageInputChannels(stage), cmsStageOutputChannels(stage));
+        auto copy = cmsStageDup(stage);
+        if (!single || !copy || !cmsPipelineInsertStage(single, cmsAT_END, copy)) {
+            if (single) {
+                cmsPipelineFree(single);
+            }
+            std::cerr << "Cannot copy stage " << index << " of " << signatureName(sig) << std::endl;
+            return false;
+        }
+
+        StageReport report;
+        report.tag = signatureName(sig);
+        report.index = index;
+        report.type = signatureName(cmsStageType(stage));
+        report.input = spaceName(space);
+        report.nsPerPixel = nsPerPixel(single, input, output);
+        cmsPipelineFree(single);
+
+        space = identifySpace(output, analytic);
+        report.output = spaceName(space);
+        if (space != Space::Unknown) {
+            const auto &expected = analytic[static_cast<size_t>(space)];
+            cmsFloat64Number sum = 0;
+            for (size_t i = 0; i < output.size(); i++) {
+                const auto difference = (static_cast<cmsFloat64Number>(output[i]) - expected[i]) * codeValues;
+                const auto error = std::max(difference, -difference);
+                report.errorMax = std::max(report.errorMax, error);
+                sum += error;
+            }
+            report.errorMean = sum / static_cast<cmsFloat64Number>(output.size());
+            report.hasError = true;
+            input = expected;
+        } else {
+            input = std::move(output);
+            output = Batch{};
+        }
+        stages.push_back(report);
+    }
+    return true;
+}
+} // namespace
+
+bool profileStages(cmsContext ctx, const std::vector<cmsUInt8Number> &profile, const Params &params, std::vector<StageReport> &stages)
+{
+    auto hProfile = cmsOpenProfileFromMemTHR(ctx, profile.data(), static_cast<cmsUInt32Number>(profile.size()));
+    if (!hProfile) {
+        return false;
+    }
+
+    const auto analytic = analyticBatches(params);
+    bool ok = true;
+    for (const auto &tag : {std::make_pair(cmsSigAToB0Tag, Space::YCbCr),
+                            std::make_pair(cmsSigBToA0Tag, Space::XYZ),
+                            std::make_pair(cmsSigDToB0Tag, Space::YCbCr),
+                            std::make_pair(cmsSigBToD0Tag, Space::XYZ)}) {
+        ok = profileTag(ctx, hProfile, tag.first, tag.second, analytic, stages) && ok;
+    }
+
+    cmsCloseProfile(hProfile);
+    return ok;
+}
+
+void printStageReportHeader(std::ostream &out)
+{
+    out << "profile\ttag\tstage\ttype\tinput\toutput\tns_px\terr_max\terr_mean\n";
+}
+
+void printStageReport(std::ostream &out, const std::string &name, const std::vector<StageReport> &stages)
+{
+    for (const auto &s : stages) {
+        out << name << '\t' << s.tag << '\t' << s.index << '\t' << s.type << '\t' << s.input << '\t' << s.output << '\t' << std::fixed
+            << std::setprecision(2) << s.nsPerPixel << '\t';
+        if (s.hasError) {
+            out << std::setprecision(3) << s.errorMax << '\t' << s.errorMean << '\n';
+        } else {
+            out << "-\t-\n";
+        }
+    }
+    out << std::flush;
+}
+} // namespace ycbcr
@@ -0,0 +1,51 @@
+// SPDX-FileCopyrightText: 2022 Amyspark <amy@amyspark.me>
+// SPDX-License-Identifier: BSD-3-Clause
+
+#pragma once
+
+#include <lcms2.h>
+
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "ycbcr_profile.h"
+
+namespace ycbcr
+{
+// Cost and accuracy of one stage of a pipeline tag.
+struct StageReport {
+    // A2B0, B2A0, D2B0 or B2D0.
+    std::string tag;
+    // Position in the pipeline, from 0.
+    size_t index = 0;
+    // Stage type signature, e.g. clut, cvst (curves) or matf (matrix).
+    std::string type;
+    // The color spaces the stage converts between, as identified against
+    // the analytic pipeline: ycbcr, ycbcr_centered (chroma in [-0.5, 0.5]),
+    // rgb_prime (normalized R'G'B'), rgb (linear), xyz, or ? if none
+    // matches (e.g. the warped XYZ of the v2 shaper curves).
+    std::string input;
+    std::string output;
+    // Time to evaluate the stage alone, in floating point.
+    cmsFloat64Number nsPerPixel = 0;
+    // Largest channel error of the output against the analytic one, given
+    // the analytic input, in 16-bit code values (1/65535). Only valid when
+    // the output space is known.
+    bool hasError = false;
+    cmsFloat64Number errorMax = 0;
+    cmsFloat64Number errorMean = 0;
+};
+
+// Times every stage of the AToB0, BToA0, DToB0 and BToD0 tags of a profile
+// built from params, each on its own, over a batch of in-gamut colors, and
+// measures their error against the analytic pipeline. Run it on an otherwise
+// idle machine.
+bool profileStages(cmsContext ctx, const std::vector<cmsUInt8Number> &profile, const Params &params, std::vector<StageReport> &stages);
+
+// Writes the header line of printStageReport.
+void printStageReportHeader(std::ostream &out);
+
+// Writes one tab separated line per stage.
+void printStageReport(std::ostream &out, const std::string &name, const std::vector<StageReport> &stages);
+} // namespace ycbcr
@@ -0,0 +1,243 @@
+// SPDX-FileCopyrightText: 2022 Amyspark <amy@amyspark.me>
+// SPDX-License-Identifier: BSD-3-Clause
+
+#include "ycbcr_sweep.h"
+
+#include <algorithm>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+
+#include "ycbcr_reference.h"
+
+namespace ycbcr
+{
+namespace
+{
+// The test colors are the centers of a lattice of cells in R'G'B', so that
+// they are in gamut and (mostly) away from the CLUT nodes.
+constexpr size_t latticeSize = 32;
+
+// CIEDE2000 a compact tag may stray from the full one beyond the error of
+// the latter, to allow for single precision evaluation.
+constexpr cmsFloat64Number compactTolerance = 0.001;
+
+// Frame used for the throughput measurements.
+constexpr cmsUInt32Number frameWidth = 960;
+constexpr cmsUInt32Number frameHeight = 540;
+
+// Minimum time spent transforming frames, per measurement.
+constexpr std::chrono::milliseconds minimumDuration{250};
+
+class ErrorAccumulator
+{
+public:
+    void add(cmsFloat64Number e)
+    {
+        stats.max = std::max(stats.max, e);
+        sum += e;
+        count++;
+    }
+
+    ErrorStats result() const
+    {
+        auto r = stats;
+        r.mean = count ? sum / static_cast<cmsFloat64Number>(count) : 0;
+        return r;
+    }
+
+private:
+    ErrorStats stats;
+    cmsFloat64Number sum = 0;
+    size_t count = 0;
+};
+
+Triplet evaluate(const cmsPipeline *lut, const Triplet &in)
+{
+    const std::array<cmsFloat32Number, 3> input = {static_cast<cmsFloat32Number>(in[0]),
+                                                   static_cast<cmsFloat32Number>(in[1]),
+                                                   static_cast<cmsFloat32Number>(in[2])};
+    std::array<cmsFloat32Number, 3> output{};
+    cmsPipelineEvalFloat(input.data(), output.data(), lut);
+    return {output[0], output[1], output[2]};
+}
+
+cmsFloat64Number framesPerSecond(cmsHTRANSFORM transform, const std::vector<cmsUInt8Number> &input, std::vector<cmsUInt8Number> &output)
+{
+    using clock = std::chrono::steady_clock;
+
+    size_t frames = 0;
+    const auto start = clock::now();
+    auto elapsed = clock::duration::zero();
+    do {
+        cmsDoTransform(transform, input.data(), output.data(), frameWidth * frameHeight);
+        frames++;
+        elapsed = clock::now() - start;
+    } while (elapsed < minimumDuration);
+
+    return static_cast<cmsFloat64Number>(frames) / std::chrono::duration<cmsFloat64Number>(elapsed).count();
+}
+} // namespace
+
+bool measureAccuracy(cmsContext ctx, const std::vector<cmsUInt8Number> &profile, SweepResult &result)
+{
+    auto hProfile = cmsOpenProfileFromMemTHR(ctx, profile.data(), static_cast<cmsUInt32Number>(profile.size()));
+    if (!hProfile) {
+        return false;
+    }
+
+    const auto *aToB0 = reinterpret_cast<const cmsPipeline *>(cmsReadTag(hProfile, cmsSigAToB0Tag));
+    const auto *bToA0 = reinterpret_cast<const cmsPipeline *>(cmsReadTag(hProfile, cmsSigBToA0Tag));
+    if (!aToB0 || !bToA0) {
+        std::cerr << "Profile " << profileName(result.params) << " lacks the AToB0/BToA0 tags" << std::endl;
+        cmsCloseProfile(hProfile);
+        return false;
+    }
+
+    const auto white = whitePoint(result.params);
+    ErrorAccumulator decode, encode;
+    for (size_t r = 0; r < latticeSize; r++) {
+        for (size_t g = 0; g < latticeSize; g++) {
+            for (size_t b = 0; b < latticeSize; b++) {
+                const auto step = 1.0 / static_cast<cmsFloat64Number>(latticeSize);
+                const Triplet rgb = {(r + 0.5) * step, (g + 0.5) * step, (b + 0.5) * step};
+                const auto ycbcr = rgbToYCbCr(result.params, rgb);
+                const auto xyz = yCbCrToXYZ(result.params, ycbcr);
+
+                decode.add(deltaE(white, xyz, evaluate(aToB0, ycbcr)));
+                encode.add(deltaE(white, xyz, yCbCrToXYZ(result.params, evaluate(bToA0, xyz))));
+            }
+        }
+    }
+
+    result.bytes = profile.size();
+    result.decodeError = decode.result();
+    result.encodeError = encode.result();
+
+    cmsCloseProfile(hProfile);
+    return true;
+}
+
+bool checkCompact(cmsContext ctx, const std::vector<cmsUInt8Number> &full, const std::vector<cmsUInt8Number> &compact, const Params &params)
+{
+    auto fullProfile = cmsOpenProfileFromMemTHR(ctx, full.data(), static_cast<cmsUInt32Number>(full.size()));
+    auto compactProfile = cmsOpenProfileFromMemTHR(ctx, compact.data(), static_cast<cmsUInt32Number>(compact.size()));
+    if (!fullProfile || !compactProfile) {
+        if (fullProfile) {
+            cmsCloseProfile(fullProfile);
+        }
+        if (compactProfile) {
+            cmsCloseProfile(compactProfile);
+        }
+        return false;
+    }
+
+    const auto white = whitePoint(params);
+    bool ok = true;
+    for (const auto &tag : {std::make_pair(cmsSigAToB0Tag, "AToB0"),
+                            std::make_pair(cmsSigBToA0Tag, "BToA0"),
+                            std::make_pair(cmsSigDToB0Tag, "DToB0"),
+                            std::make_pair(cmsSigBToD0Tag, "BToD0")}) {
+        const auto *fullLut = reinterpret_cast<const cmsPipeline *>(cmsReadTag(fullProfile, tag.first));
+        const auto *compactLut = reinterpret_cast<const cmsPipeline *>(cmsReadTag(compactProfile, tag.first));
+        if (!fullLut != !compactLut) {
+            std::cerr << "Profile " << profileName(params) << " and its full counterpart differ in their " << tag.second << " tags" << std::endl;
+            ok = false;
+            continue;
+        }
+        if (!fullLut) {
+            // v2 profiles have no DToB0/BToD0 tags.
+            continue;
+        }
+
+        const auto decodes = tag.first == cmsSigAToB0Tag || tag.first == cmsSigDToB0Tag;
+        ErrorAccumulator fullError, difference;
+        for (size_t r = 0; r < latticeSize; r++) {
+            for (size_t g = 0; g < latticeSize; g++) {
+                for (size_t b = 0; b < latticeSize; b++) {
+                    const auto step = 1.0 / static_cast<cmsFloat64Number>(latticeSize);
+                    const Triplet rgb = {(r + 0.5) * step, (g + 0.5) * step, (b + 0.5) * step};
+                    const auto ycbcr = rgbToYCbCr(params, rgb);
+                    const auto xyz = yCbCrToXYZ(params, ycbcr);
+                    if (decodes) {
+                        const auto fullXYZ = evaluate(fullLut, ycbcr);
+                        fullError.add(deltaE(white, xyz, fullXYZ));
+                        difference.add(deltaE(white, fullXYZ, evaluate(compactLut, ycbcr)));
+                    } else {
+                        const auto fullXYZ = yCbCrToXYZ(params, evaluate(fullLut, xyz));
+                        fullError.add(deltaE(white, yCbCrToXYZ(params, xyzToYCbCr(params, xyz)), fullXYZ));
+                        difference.add(deltaE(white, fullXYZ, yCbCrToXYZ(params, evaluate(compactLut, xyz))));
+                    }
+                }
+            }
+        }
+
+        const auto limit = fullError.result().max + compactTolerance;
+        if (difference.result().max > limit) {
+            std::cerr << "The " << tag.second << " tag of " << profileName(params) << " differs from the full profile's by up to "
+                      << difference.result().max << ", beyond the " << limit << " the latter is off by" << std::endl;
+            ok = false;
+        }
+    }
+
+    cmsCloseProfile(compactProfile);
+    cmsCloseProfile(fullProfile);
+    return ok;
+}
+
+bool measureThroughput(cmsContext ctx, const std::vector<cmsUInt8Number> &profile, SweepResult &result)
+{
+    auto hProfile = cmsOpenProfileFromMemTHR(ctx, profile.data(), static_cast<cmsUInt32Number>(profile.size()));
+    auto sRGB = cmsCreate_sRGBProfileTHR(ctx);
+    if (!hProfile || !sRGB) {
+        if (hProfile) {
+            cmsCloseProfile(hProfile);
+        }
+        if (sRGB) {
+            cmsCloseProfile(sRGB);
+        }
+        return false;
+    }
+
+    // A deterministic, incompressible-looking frame.
+    std::vector<cmsUInt8Number> input(frameWidth * frameHeight * T_CHANNELS(TYPE_YCbCr_8));
+    cmsUInt32Number seed = 0x12345678;
+    for (auto &v : input) {
+        seed = seed * 1664525U + 1013904223U;
+        v = static_cast<cmsUInt8Number>(seed >> 24);
+    }
+    std::vector<cmsUInt8Number> output(frameWidth * frameHeight * T_CHANNELS(TYPE_RGB_8));
+
+    bool ok = true;
+    for (const auto flags : {0U, static_cast<cmsUInt32Number>(cmsFLAGS_NOOPTIMIZE)}) {
+        auto transform = cmsCreateTransformTHR(ctx, hProfile, TYPE_YCbCr_8, sRGB, TYPE_RGB_8, INTENT_PERCEPTUAL, flags);
+        if (!transform) {
+            ok = false;
+            break;
+        }
+        const auto mpix = framesPerSecond(transform, input, output) * frameWidth * frameHeight / 1e6;
+        (flags ? result.throughputNoOptimize : result.throughput) = mpix;
+        cmsDeleteTransform(transform);
+    }
+
+    cmsCloseProfile(sRGB);
+    cmsCloseProfile(hProfile);
+    return ok;
+}
+
+void printSweepReport(std::ostream &out, const std::vector<SweepResult> &results)
+{
+    out << "profile\tresolution\tbytes\tmpix_s\tmpix_s_nooptimize\tdecode_de_max\tdecode_de_mean\tencode_de_max\tencode_de_mean\n";
+    for (const auto &r : results) {
+        // Variants that could not be built or measured have no row, the
+        // generator reports them and fails.
+        if (!r.bytes) {
+            continue;
+        }
+        out << profileName(r.params) << '\t' << r.params.resolution << '\t' << r.bytes << '\t' << std::fixed << std::setprecision(2) << r.throughput
+            << '\t' << r.throughputNoOptimize << '\t' << std::setprecision(4) << r.decodeError.max << '\t' << r.decodeError.mean << '\t'
+            << r.encodeError.max << '\t' << r.encodeError.mean << '\n';
+    }
+    out << std::flush;
+}
+} // namespace ycbcr
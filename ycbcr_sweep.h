@@ -0,0 +1,49 @@
+// SPDX-FileCopyrightText: 2022 Amyspark <amy@amyspark.me>
+// SPDX-License-Identifier: BSD-3-Clause
+
+#pragma once
+
+#include <lcms2.h>
+
+#include <ostream>
+#include <vector>
+
+#include "ycbcr_profile.h"
+
+namespace ycbcr
+{
+// CIEDE2000 statistics over the test set.
+struct ErrorStats {
+    cmsFloat64Number max = 0;
+    cmsFloat64Number mean = 0;
+};
+
+struct SweepResult {
+    Params params;
+    // Size of the serialized profile.
+    size_t bytes = 0;
+    // AToB0 (YCbCr -> XYZ) and BToA0 (XYZ -> YCbCr) against the analytic
+    // pipeline, over a lattice of in-gamut colors.
+    ErrorStats decodeError;
+    ErrorStats encodeError;
+    // Megapixels per second of an 8-bit YCbCr -> sRGB cmsDoTransform, with
+    // the default flags and with cmsFLAGS_NOOPTIMIZE (i.e. interpolating
+    // the profile's own CLUT).
+    cmsFloat64Number throughput = 0;
+    cmsFloat64Number throughputNoOptimize = 0;
+};
+
+// Fills in the size and error columns. Each thread must use its own context.
+bool measureAccuracy(cmsContext ctx, const std::vector<cmsUInt8Number> &profile, SweepResult &result);
+
+// Checks that a compact profile gives the colors of the full one it was
+// derived from: that each pipeline tag differs from its full counterpart
+// by no more than the full tag itself does from the analytic pipeline.
+bool checkCompact(cmsContext ctx, const std::vector<cmsUInt8Number> &full, const std::vector<cmsUInt8Number> &compact, const Params &params);
+
+// Fills in the throughput columns. Run it on an otherwise idle machine.
+bool measureThroughput(cmsContext ctx, const std::vector<cmsUInt8Number> &profile, SweepResult &result);
+
+// Writes the results as tab separated values, with a header line.
+void printSweepReport(std::ostream &out, const std::vector<SweepResult> &results);
+} // namespace ycbcr
@@ -0,0 +1,108 @@
+// SPDX-FileCopyrightText: 2022 Amyspark <amy@amyspark.me>
+// SPDX-License-Identifier: BSD-3-Clause
+
+#include "ycbcr_tags.h"
+
+#include <algorithm>
+#include <iostream>
+
+namespace ycbcr
+{
+namespace
+{
+// ICC.1:2010, 7.2 and 7.3.
+constexpr size_t headerSize = 128;
+constexpr size_t tagEntrySize = 12;
+
+cmsUInt32Number readUInt32(const std::vector<cmsUInt8Number> &profile, size_t offset)
+{
+    return static_cast<cmsUInt32Number>(profile[offset]) << 24 | static_cast<cmsUInt32Number>(profile[offset + 1]) << 16
+        | static_cast<cmsUInt32Number>(profile[offset + 2]) << 8 | static_cast<cmsUInt32Number>(profile[offset + 3]);
+}
+
+// A signature as its four characters, without the trailing spaces.
+std::string signatureName(const std::vector<cmsUInt8Number> &profile, size_t offset)
+{
+    std::string name(profile.begin() + static_cast<std::ptrdiff_t>(offset), profile.begin() + static_cast<std::ptrdiff_t>(offset + 4));
+    name.erase(name.find_last_not_of(' ') + 1);
+    return name;
+}
+
+struct TagEntry {
+    cmsUInt32Number offset;
+    cmsUInt32Number size;
+};
+} // namespace
+
+bool readTagSizes(const std::vector<cmsUInt8Number> &profile, std::vector<TagSize> &tags)
+{
+    if (profile.size() < headerSize + 4) {
+        return false;
+    }
+    const auto count = readUInt32(profile, headerSize);
+    if (profile.size() < headerSize + 4 + tagEntrySize * count) {
+        return false;
+    }
+
+    std::vector<TagEntry> entries;
+    for (size_t i = 0; i < count; i++) {
+        const auto entry = headerSize + 4 + tagEntrySize * i;
+        const TagEntry tag{readUInt32(profile, entry + 4), readUInt32(profile, entry + 8)};
+        if (tag.size < 4 || tag.offset > profile.size() || tag.size > profile.size() - tag.offset) {
+            return false;
+        }
+        entries.push_back(tag);
+    }
+
+    // The padding after each tag goes up to the next one in the file.
+    std::vector<cmsUInt32Number> offsets;
+    for (const auto &entry : entries) {
+        offsets.push_back(entry.offset);
+    }
+    std::sort(offsets.begin(), offsets.end());
+
+    tags.clear();
+    for (size_t i = 0; i < entries.size(); i++) {
+        const auto entry = headerSize + 4 + tagEntrySize * i;
+        TagSize tag;
+        tag.signature = signatureName(profile, entry);
+        tag.type = signatureName(profile, entries[i].offset);
+        const auto shared = std::find_if(entries.begin(), entries.begin() + static_cast<std::ptrdiff_t>(i), [&](const TagEntry &e) {
+            return e.offset == entries[i].offset;
+        });
+        if (shared != entries.begin() + static_cast<std::ptrdiff_t>(i)) {
+            tag.sharedWith = tags[static_cast<size_t>(shared - entries.begin())].signature;
+        } else {
+            const auto next = std::upper_bound(offsets.begin(), offsets.end(), entries[i].offset);
+            tag.bytes = (next == offsets.end() ? profile.size() : *next) - entries[i].offset;
+        }
+        tags.push_back(tag);
+    }
+    return true;
+}
+
+void printTagReportHeader(std::ostream &out)
+{
+    out << "profile\ttag\ttype\tbytes\tshared_with\n";
+}
+
+bool printTagReport(std::ostream &out, const std::string &name, const std::vector<cmsUInt8Number> &profile)
+{
+    std::vector<TagSize> tags;
+    if (!readTagSizes(profile, tags)) {
+        std::cerr << "Malformed tag table in " << name << std::endl;
+        return false;
+    }
+    // The header and tag table, along with any padding before the first tag.
+    auto header = profile.size();
+    for (const auto &tag : tags) {
+        header -= tag.bytes;
+    }
+    out << name << "\theader\t-\t" << header << "\t-\n";
+    for (const auto &tag : tags) {
+        out << name << '\t' << tag.signature << '\t' << tag.type << '\t' << tag.bytes << '\t' << (tag.sharedWith.empty() ? "-" : tag.sharedWith) << '\n';
+    }
+    out << name << "\ttotal\t-\t" << profile.size() << "\t-\n" << std::flush;
+    return true;
+}
+} // namespace ycbcr
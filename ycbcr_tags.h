@@ -0,0 +1,37 @@
+// SPDX-FileCopyrightText: 2022 Amyspark <amy@amyspark.me>
+// SPDX-License-Identifier: BSD-3-Clause
+
+#pragma once
+
+#include <lcms2.h>
+
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace ycbcr
+{
+// A tag of a serialized profile.
+struct TagSize {
+    // Signature and type signature, e.g. A2B0 and mAB.
+    std::string signature;
+    std::string type;
+    // Bytes taken by its data, including the padding up to the next tag;
+    // zero if it shares the data of another tag.
+    size_t bytes = 0;
+    // Signature of the tag it shares its data with, if any.
+    std::string sharedWith;
+};
+
+// Reads the tag table of a serialized profile. Returns false if it's
+// malformed.
+bool readTagSizes(const std::vector<cmsUInt8Number> &profile, std::vector<TagSize> &tags);
+
+// Writes the header line of printTagReport.
+void printTagReportHeader(std::ostream &out);
+
+// Writes the byte breakdown of a serialized profile as tab separated values:
+// one line for the header and tag table, one per tag, and one for the total.
+// Returns false if the tag table is malformed.
+bool printTagReport(std::ostream &out, const std::string &name, const std::vector<cmsUInt8Number> &profile);
+} // namespace ycbcr
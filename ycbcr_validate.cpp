@@ -0,0 +1,305 @@
+// SPDX-FileCopyrightText: 2022 Amyspark <amy@amyspark.me>
+// SPDX-License-Identifier: BSD-3-Clause
+
+#include "ycbcr_validate.h"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cmath>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
+
+#include "ycbcr_reference.h"
+
+namespace ycbcr
+{
+namespace
+{
+constexpr size_t codeLevels = 1024;
+constexpr cmsFloat64Number codeMaximum = codeLevels - 1;
+// Code values go by rows of every Cr for a given Y and Cb.
+constexpr size_t rowCount = codeLevels * codeLevels;
+// Rows claimed at a time by each thread.
+constexpr size_t rowBatch = 64;
+
+// Slack of the gamut test, so that the corners of the R'G'B' cube aren't
+// rejected because of rounding.
+constexpr cmsFloat64Number gamutTolerance = 1e-9;
+
+constexpr cmsFloat64Number deltaEBinWidth = 1e-3;
+constexpr size_t deltaEBins = 20000;
+constexpr cmsFloat64Number codeErrorBinWidth = 1.0 / 256;
+constexpr size_t codeErrorBins = 16384;
+
+struct TagPair {
+    cmsTagSignature forward;
+    cmsTagSignature backward;
+    const char *name;
+};
+
+constexpr std::array<TagPair, 2> tagPairs = {{
+    {cmsSigAToB0Tag, cmsSigBToA0Tag, "AToB0/BToA0"},
+    {cmsSigDToB0Tag, cmsSigBToD0Tag, "DToB0/BToD0"},
+}};
+
+struct Pipelines {
+    const cmsPipeline *forward;
+    const cmsPipeline *backward;
+};
+
+Histogram makeHistogram(cmsFloat64Number binWidth, size_t bins)
+{
+    Histogram h{};
+    h.binWidth = binWidth;
+    h.bins.resize(bins);
+    return h;
+}
+
+void add(Histogram &h, cmsFloat64Number value)
+{
+    const auto bin = std::min(static_cast<size_t>(value / h.binWidth), h.bins.size() - 1);
+    h.bins[bin]++;
+    h.count++;
+    h.sum += value;
+    h.max = std::max(h.max, value);
+}
+
+bool merge(Histogram &h, const Histogram &other)
+{
+    if (h.binWidth != other.binWidth || h.bins.size() != other.bins.size()) {
+        return false;
+    }
+    for (size_t i = 0; i < h.bins.size(); i++) {
+        h.bins[i] += other.bins[i];
+    }
+    h.count += other.count;
+    h.sum += other.sum;
+    h.max = std::max(h.max, other.max);
+    return true;
+}
+
+bool merge(RoundTripStats &stats, const RoundTripStats &other)
+{
+    stats.outOfGamut += other.outOfGamut;
+    return merge(stats.deltaE, other.deltaE) && merge(stats.codeError, other.codeError);
+}
+
+// The upper edge of the bin holding the given fraction of the samples,
+// capped at the maximum.
+cmsFloat64Number percentile(const Histogram &h, cmsFloat64Number fraction)
+{
+    const auto target = static_cast<uint64_t>(std::ceil(fraction * static_cast<cmsFloat64Number>(h.count)));
+    uint64_t seen = 0;
+    for (size_t i = 0; i < h.bins.size(); i++) {
+        seen += h.bins[i];
+        if (seen >= target && seen > 0) {
+            return std::min(static_cast<cmsFloat64Number>(i + 1) * h.binWidth, h.max);
+        }
+    }
+    return h.max;
+}
+
+cmsFloat64Number mean(const Histogram &h)
+{
+    return h.count ? h.sum / static_cast<cmsFloat64Number>(h.count) : 0;
+}
+
+bool inGamut(const Triplet &rgb)
+{
+    return std::all_of(rgb.begin(), rgb.end(), [](cmsFloat64Number v) {
+        return v >= -gamutTolerance && v <= 1 + gamutTolerance;
+    });
+}
+
+void validateRows(const Params &params,
+                  const cmsCIEXYZ &white,
+                  const std::vector<Pipelines> &pipelines,
+                  size_t endRow,
+                  std::atomic<size_t> &nextRow,
+                  std::vector<RoundTripStats> &stats)
+{
+    for (auto first = nextRow.fetch_add(rowBatch); first < endRow; first = nextRow.fetch_add(rowBatch)) {
+        for (auto row = first; row < std::min(first + rowBatch, endRow); row++) {
+            for (size_t cr = 0; cr < codeLevels; cr++) {
+                const Triplet ycbcr = {static_cast<cmsFloat64Number>(row / codeLevels) / codeMaximum,
+                                       static_cast<cmsFloat64Number>(row % codeLevels) / codeMaximum,
+                                       static_cast<cmsFloat64Number>(cr) / codeMaximum};
+                if (!inGamut(yCbCrToRGB(params, ycbcr))) {
+                    for (auto &s : stats) {
+                        s.outOfGamut++;
+                    }
+                    continue;
+                }
+                const auto xyz = yCbCrToXYZ(params, ycbcr);
+                const std::array<cmsFloat32Number, 3> input = {static_cast<cmsFloat32Number>(ycbcr[0]),
+                                                               static_cast<cmsFloat32Number>(ycbcr[1]),
+                                                               static_cast<cmsFloat32Number>(ycbcr[2])};
+                for (size_t i = 0; i < pipelines.size(); i++) {
+                    std::array<cmsFloat32Number, 3> pcs{}, output{};
+                    cmsPipelineEvalFloat(input.data(), pcs.data(), pipelines[i].forward);
+                    cmsPipelineEvalFloat(pcs.data(), output.data(), pipelines[i].backward);
+                    const Triplet result = {output[0], output[1], output[2]};
+
+                    add(stats[i].deltaE, deltaE(white, xyz, yCbCrToXYZ(params, result)));
+                    cmsFloat64Number codeError = 0;
+                    for (size_t k = 0; k < 3; k++) {
+                        codeError = std::max(codeError, std::abs(result[k] - ycbcr[k]) * codeMaximum);
+                    }
+                    add(stats[i].codeError, codeError);
+                }
+            }
+        }
+    }
+}
+
+void writeHistogram(std::ostream &out, const Histogram &h)
+{
+    out << ' ' << h.binWidth << ' ' << h.bins.size() << ' ' << h.count << ' ' << h.sum << ' ' << h.max << ' ';
+    bool empty = true;
+    for (size_t i = 0; i < h.bins.size(); i++) {
+        if (h.bins[i]) {
+            out << (empty ? "" : ",") << i << ':' << h.bins[i];
+            empty = false;
+        }
+    }
+    if (empty) {
+        out << '-';
+    }
+}
+
+bool readHistogram(std::istream &in, Histogram &h)
+{
+    size_t bins = 0;
+    std::string sparse;
+    if (!(in >> h.binWidth >> bins >> h.count >> h.sum >> h.max >> sparse) || bins == 0 || h.binWidth <= 0) {
+        return false;
+    }
+    h.bins.assign(bins, 0);
+    if (sparse == "-") {
+        return true;
+    }
+    std::stringstream entries(sparse);
+    std::string entry;
+    while (std::getline(entries, entry, ',')) {
+        const auto colon = entry.find(':');
+        if (colon == std::string::npos) {
+            return false;
+        }
+        try {
+            const auto i = std::stoull(entry.substr(0, colon));
+            if (i >= bins) {
+                return false;
+            }
+            h.bins[i] = std::stoull(entry.substr(colon + 1));
+        } catch (const std::exception &) {
+            return false;
+        }
+    }
+    return true;
+}
+} // namespace
+
+bool validateProfile(cmsContext ctx, const std::vector<cmsUInt8Number> &profile, const Params &params, const Shard &shard, unsigned int threads, std::vector<RoundTripStats> &results)
+{
+    auto hProfile = cmsOpenProfileFromMemTHR(ctx, profile.data(), static_cast<cmsUInt32Number>(profile.size()));
+    if (!hProfile) {
+        return false;
+    }
+
+    // The tags are read once; evaluating them from several threads doesn't
+    // touch the profile.
+    std::vector<Pipelines> pipelines;
+    std::vector<RoundTripStats> total;
+    for (const auto &pair : tagPairs) {
+        const auto *forward = reinterpret_cast<const cmsPipeline *>(cmsReadTag(hProfile, pair.forward));
+        const auto *backward = reinterpret_cast<const cmsPipeline *>(cmsReadTag(hProfile, pair.backward));
+        if (!forward || !backward) {
+            continue;
+        }
+        pipelines.push_back({forward, backward});
+        total.push_back({profileName(params), pair.name, 0, makeHistogram(deltaEBinWidth, deltaEBins), makeHistogram(codeErrorBinWidth, codeErrorBins)});
+    }
+    if (pipelines.empty()) {
+        std::cerr << "Profile " << profileName(params) << " lacks the AToB0/BToA0 tags" << std::endl;
+        cmsCloseProfile(hProfile);
+        return false;
+    }
+
+    const auto white = whitePoint(params);
+    const auto beginRow = rowCount * shard.index / shard.count;
+    const auto endRow = rowCount * (shard.index + 1) / shard.count;
+    std::atomic<size_t> nextRow{beginRow};
+    std::vector<std::vector<RoundTripStats>> partial(std::max(1U, threads), total);
+    std::vector<std::thread> workers;
+    for (size_t i = 1; i < partial.size(); i++) {
+        workers.emplace_back(validateRows, std::cref(params), std::cref(white), std::cref(pipelines), endRow, std::ref(nextRow), std::ref(partial[i]));
+    }
+    validateRows(params, white, pipelines, endRow, nextRow, partial[0]);
+    for (auto &t : workers) {
+        t.join();
+    }
+
+    for (const auto &p : partial) {
+        for (size_t i = 0; i < total.size(); i++) {
+            merge(total[i], p[i]);
+        }
+    }
+    results.insert(results.end(), total.begin(), total.end());
+
+    cmsCloseProfile(hProfile);
+    return true;
+}
+
+void writeValidationShard(std::ostream &out, const std::vector<RoundTripStats> &results)
+{
+    out << std::setprecision(17);
+    for (const auto &r : results) {
+        out << r.profile << ' ' << r.tags << ' ' << r.outOfGamut;
+        writeHistogram(out, r.deltaE);
+        writeHistogram(out, r.codeError);
+        out << '\n';
+    }
+    out << std::flush;
+}
+
+bool mergeValidationShard(std::istream &in, std::vector<RoundTripStats> &results)
+{
+    std::string line;
+    while (std::getline(in, line)) {
+        if (line.empty()) {
+            continue;
+        }
+        std::stringstream fields(line);
+        RoundTripStats stats{};
+        if (!(fields >> stats.profile >> stats.tags >> stats.outOfGamut) || !readHistogram(fields, stats.deltaE) || !readHistogram(fields, stats.codeError)) {
+            std::cerr << "Invalid shard line: " << line << std::endl;
+            return false;
+        }
+        const auto it = std::find_if(results.begin(), results.end(), [&](const RoundTripStats &r) {
+            return r.profile == stats.profile && r.tags == stats.tags;
+        });
+        if (it == results.end()) {
+            results.push_back(std::move(stats));
+        } else if (!merge(*it, stats)) {
+            std::cerr << "Mismatched histograms for " << stats.profile << " " << stats.tags << std::endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+void printValidationReport(std::ostream &out, const std::vector<RoundTripStats> &results)
+{
+    out << "profile\ttags\tcodes\tout_of_gamut\tde_max\tde_mean\tde_p99\tcode_max\tcode_mean\tcode_p99\n";
+    for (const auto &r : results) {
+        out << r.profile << '\t' << r.tags << '\t' << r.deltaE.count << '\t' << r.outOfGamut << '\t' << std::fixed << std::setprecision(4) << r.deltaE.max
+            << '\t' << mean(r.deltaE) << '\t' << percentile(r.deltaE, 0.99) << '\t' << r.codeError.max << '\t' << mean(r.codeError) << '\t'
+            << percentile(r.codeError, 0.99) << '\n';
+    }
+    out << std::flush;
+}
+} // namespace ycbcr
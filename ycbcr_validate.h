@@ -0,0 +1,63 @@
+// SPDX-FileCopyrightText: 2022 Amyspark <amy@amyspark.me>
+// SPDX-License-Identifier: BSD-3-Clause
+
+#pragma once
+
+#include <lcms2.h>
+
+#include <cstdint>
+#include <istream>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "ycbcr_profile.h"
+
+namespace ycbcr
+{
+// The index-th of count equal parts of the 2^30 10-bit YCbCr code values.
+struct Shard {
+    unsigned int index = 0;
+    unsigned int count = 1;
+};
+
+// Error distribution, binned so that shards can be merged and percentiles
+// taken without keeping every sample.
+struct Histogram {
+    cmsFloat64Number binWidth = 0;
+    uint64_t count = 0;
+    cmsFloat64Number sum = 0;
+    cmsFloat64Number max = 0;
+    // The last bin takes everything beyond the others.
+    std::vector<uint64_t> bins;
+};
+
+// Round trip through a pair of tags, against the analytic pipeline, over
+// the code values that decode to R'G'B' in [0, 1]. The others can't
+// survive the clamping of the CLUTs, and are only counted.
+struct RoundTripStats {
+    std::string profile;
+    // AToB0/BToA0 or DToB0/BToD0.
+    std::string tags;
+    uint64_t outOfGamut = 0;
+    // CIEDE2000 between the analytic XYZ of the code value and of the round
+    // trip's result.
+    Histogram deltaE;
+    // Largest difference of the three channels, in 10-bit code values.
+    Histogram codeError;
+};
+
+// Runs every code value of the shard through each pair of tags the profile
+// has, on the given number of threads.
+bool validateProfile(cmsContext ctx, const std::vector<cmsUInt8Number> &profile, const Params &params, const Shard &shard, unsigned int threads, std::vector<RoundTripStats> &results);
+
+// Writes the raw statistics of a shard, one pair of tags per line.
+void writeValidationShard(std::ostream &out, const std::vector<RoundTripStats> &results);
+
+// Reads the output of writeValidationShard, adding it to results. Returns
+// false if the input is malformed.
+bool mergeValidationShard(std::istream &in, std::vector<RoundTripStats> &results);
+
+// Writes the results as tab separated values, with a header line.
+void printValidationReport(std::ostream &out, const std::vector<RoundTripStats> &results);
+} // namespace ycbcr
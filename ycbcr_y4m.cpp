@@ -0,0 +1,634 @@
+// SPDX-FileCopyrightText: 2022 Amyspark <amy@amyspark.me>
+// SPDX-License-Identifier: BSD-3-Clause
+
+#include <lcms2.h>
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#ifdef _WIN32
+#include <fcntl.h>
+#include <io.h>
+#endif
+
+#include "ycbcr_formatters.h"
+#include "ycbcr_lcms_plugins.h"
+#include "ycbcr_optimization.h"
+
+using namespace ycbcr;
+
+namespace
+{
+using clock = std::chrono::steady_clock;
+
+// Longest stream or frame header accepted.
+constexpr size_t maxHeaderLength = 4096;
+
+enum class OutputFormat { PAM, PFM, Y4M };
+
+struct Options {
+    std::string input{"-"};
+    std::string output{"-"};
+    std::string profile;
+    std::string outputProfile;
+    OutputFormat format = OutputFormat::PAM;
+    unsigned int jobs = std::max(1U, std::thread::hardware_concurrency());
+    // Register the YCbCr optimization plugin.
+    bool plugin = false;
+    // LittleCMS' own plugins to register.
+    std::vector<LcmsPlugin> lcmsPlugins;
+};
+
+// The stream header, and the frame layout it describes.
+struct StreamInfo {
+    cmsUInt32Number width = 0;
+    cmsUInt32Number height = 0;
+    // The header fields other than the size and colorspace, kept for the
+    // Y4M output.
+    std::vector<std::string> fields;
+    cmsUInt32Number type = typeI420;
+    size_t sampleSize = 1;
+    size_t chromaWidth = 0;
+    size_t chromaHeight = 0;
+
+    size_t lumaBytes() const
+    {
+        return size_t{width} * height * sampleSize;
+    }
+
+    size_t chromaBytes() const
+    {
+        return chromaWidth * chromaHeight * sampleSize;
+    }
+
+    Frame frame(const cmsUInt8Number *data) const
+    {
+        const auto *cb = data + lumaBytes();
+        return {type, width, height, data, width * sampleSize, cb, chromaWidth * sampleSize, cb + chromaBytes(), chromaWidth * sampleSize};
+    }
+};
+
+// A frame on its way through the pipeline.
+struct Slot {
+    enum class State { Free, Decoded, Transformed };
+    State state = State::Free;
+    std::vector<cmsUInt8Number> input;
+    std::vector<cmsUInt8Number> output;
+};
+
+void log(cmsContext ctx, unsigned int errorCode, const char *msg)
+{
+    std::cerr << "context " << ctx << " error: " << errorCode << " (" << msg << ")" << std::endl;
+}
+
+void usage(const char *argv0)
+{
+    std::cerr << "Usage: " << argv0 << " [options] --profile PROFILE [INPUT]\n"
+              << "\n"
+              << "Converts a Y4M stream (4:2:0, 4:2:2 or 4:4:4, 8 or 10 bits) from INPUT, or\n"
+              << "the standard input, through PROFILE, the YCbCr profile of the stream.\n"
+              << "\n"
+              << "  --profile FILE         profile of the input\n"
+              << "  --output-profile FILE  profile of the output (default: sRGB; required,\n"
+              << "                         and YCbCr, for Y4M)\n"
+              << "  --format FORMAT        one of pam (RGB, 8 or 16 bits), pfm (RGB, floating\n"
+              << "                         point) or y4m (4:4:4, same depth as the input)\n"
+              << "                         (default: pam)\n"
+              << "  --output FILE          write the frames to FILE instead of the standard\n"
+              << "                         output\n"
+              << "  --jobs N               number of threads transforming each frame\n"
+              << "                         (default: all cores)\n"
+              << "  --plugin               register the YCbCr optimization plugin\n"
+              << "  --lcms-plugins LIST    comma separated list of LittleCMS plugins to\n"
+              << "                         register, if built with them: only fast_float, as\n"
+              << "                         frames are already split across --jobs threads\n";
+}
+
+bool littleEndian()
+{
+    const uint16_t one = 1;
+    uint8_t first = 0;
+    std::memcpy(&first, &one, 1);
+    return first == 1;
+}
+
+// Reads a header line, without its newline. Returns false on end of file or
+// on an overlong line.
+bool readLine(std::FILE *file, std::string &line)
+{
+    line.clear();
+    for (auto c = std::fgetc(file); c != EOF; c = std::fgetc(file)) {
+        if (c == '\n') {
+            return true;
+        }
+        line.push_back(static_cast<char>(c));
+        if (line.size() > maxHeaderLength) {
+            return false;
+        }
+    }
+    return false;
+}
+
+bool parseHeader(const std::string &line, StreamInfo &info)
+{
+    std::stringstream stream(line);
+    std::string field;
+    if (!(stream >> field) || field != "YUV4MPEG2") {
+        std::cerr << "Not a Y4M stream" << std::endl;
+        return false;
+    }
+    std::string colorspace{"420jpeg"};
+    while (stream >> field) {
+        if (field[0] == 'W') {
+            info.width = static_cast<cmsUInt32Number>(std::strtoul(field.c_str() + 1, nullptr, 10));
+        } else if (field[0] == 'H') {
+            info.height = static_cast<cmsUInt32Number>(std::strtoul(field.c_str() + 1, nullptr, 10));
+        } else if (field[0] == 'C') {
+            colorspace = field.substr(1);
+        } else if (field.compare(0, 7, "XYSCSS=") != 0) {
+            info.fields.push_back(field);
+        }
+    }
+    if (info.width == 0 || info.height == 0) {
+        std::cerr << "Invalid frame size " << info.width << "x" << info.height << std::endl;
+        return false;
+    }
+
+    // The chroma siting of the 4:2:0 variants is ignored, the formatters
+    // assume MPEG-2's.
+    bool halfWidth = true;
+    bool halfHeight = true;
+    if (colorspace == "420" || colorspace == "420jpeg" || colorspace == "420paldv" || colorspace == "420mpeg2") {
+        info.type = typeI420;
+    } else if (colorspace == "422") {
+        info.type = typeI422;
+        halfHeight = false;
+    } else if (colorspace == "444") {
+        info.type = typeI444;
+        halfWidth = halfHeight = false;
+    } else if (colorspace == "420p10") {
+        info.type = typeI010;
+    } else if (colorspace == "422p10") {
+        info.type = typeI210;
+        halfHeight = false;
+    } else if (colorspace == "444p10") {
+        info.type = typeI410;
+        halfWidth = halfHeight = false;
+    } else {
+        std::cerr << "Unsupported colorspace: " << colorspace << std::endl;
+        return false;
+    }
+    info.sampleSize = T_BYTES(info.type);
+    info.chromaWidth = halfWidth ? (info.width + 1) / 2 : info.width;
+    info.chromaHeight = halfHeight ? (info.height + 1) / 2 : info.height;
+    return true;
+}
+
+// Runs jobs split in bands across a fixed set of threads.
+class BandPool
+{
+public:
+    // threads is the number of threads besides the caller's.
+    explicit BandPool(unsigned int threads)
+    {
+        for (unsigned int i = 0; i < threads; i++) {
+            workers.emplace_back([this]() {
+                work();
+            });
+        }
+    }
+
+    ~BandPool()
+    {
+        {
+            const std::lock_guard<std::mutex> lock(mutex);
+            stop = true;
+        }
+        pending.notify_all();
+        for (auto &t : workers) {
+            t.join();
+        }
+    }
+
+    BandPool(const BandPool &) = delete;
+    BandPool &operator=(const BandPool &) = delete;
+
+    // Calls job for each band, from the pool and the calling thread, and
+    // returns once all of them are done.
+    void run(size_t bandCount, const std::function<void(size_t)> &job)
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        current = &job;
+        bands = bandCount;
+        next = 0;
+        finished = 0;
+        pending.notify_all();
+        while (next < bands) {
+            const auto band = next++;
+            lock.unlock();
+            job(band);
+            lock.lock();
+            finished++;
+        }
+        done.wait(lock, [this]() {
+            return finished == bands;
+        });
+        current = nullptr;
+    }
+
+private:
+    void work()
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        for (;;) {
+            pending.wait(lock, [this]() {
+                return stop || next < bands;
+            });
+            if (stop) {
+                return;
+            }
+            const auto band = next++;
+            const auto *job = current;
+            lock.unlock();
+            (*job)(band);
+            lock.lock();
+            if (++finished == bands) {
+                done.notify_all();
+            }
+        }
+    }
+
+    std::vector<std::thread> workers;
+    std::mutex mutex;
+    std::condition_variable pending;
+    std::condition_variable done;
+    const std::function<void(size_t)> *current = nullptr;
+    size_t bands = 0;
+    size_t next = 0;
+    size_t finished = 0;
+    bool stop = false;
+};
+
+bool parseOptions(int argc, char **argv, Options &options)
+{
+    for (int i = 1; i < argc; i++) {
+        const std::string arg{argv[i]};
+        if (arg == "--plugin") {
+            options.plugin = true;
+            continue;
+        }
+        if (arg.compare(0, 2, "--") != 0) {
+            options.input = arg;
+            continue;
+        }
+        if (i + 1 >= argc) {
+            return false;
+        }
+        const std::string value{argv[++i]};
+        if (arg == "--profile") {
+            options.profile = value;
+        } else if (arg == "--output-profile") {
+            options.outputProfile = value;
+        } else if (arg == "--output") {
+            options.output = value;
+        } else if (arg == "--jobs") {
+            options.jobs = std::max(1, std::atoi(value.c_str()));
+        } else if (arg == "--lcms-plugins") {
+            if (!parseLcmsPlugins(value, options.lcmsPlugins)) {
+                return false;
+            }
+            // The threaded plugin would run the frame formatters on its own
+            // threads, which don't see the row being transformed.
+            if (std::find(options.lcmsPlugins.begin(), options.lcmsPlugins.end(), LcmsPlugin::Threaded) != options.lcmsPlugins.end()) {
+                std::cerr << "The threaded plugin cannot be used with the frame formatters, use --jobs instead" << std::endl;
+                return false;
+            }
+        } else if (arg == "--format") {
+            if (value == "pam") {
+                options.format = OutputFormat::PAM;
+            } else if (value == "pfm") {
+                options.format = OutputFormat::PFM;
+            } else if (value == "y4m") {
+                options.format = OutputFormat::Y4M;
+            } else {
+                std::cerr << "Unknown format: " << value << std::endl;
+                return false;
+            }
+        } else {
+            return false;
+        }
+    }
+    return !options.profile.empty() && (options.format != OutputFormat::Y4M || !options.outputProfile.empty());
+}
+
+std::FILE *openFile(const std::string &path, bool write)
+{
+    if (path == "-") {
+        auto *file = write ? stdout : stdin;
+#ifdef _WIN32
+        _setmode(_fileno(file), _O_BINARY);
+#endif
+        return file;
+    }
+    auto *file = std::fopen(path.c_str(), write ? "wb" : "rb");
+    if (!file) {
+        std::cerr << "Cannot open " << path << std::endl;
+    }
+    return file;
+}
+
+cmsHPROFILE openProfile(cmsContext ctx, const std::string &path, cmsColorSpaceSignature colorSpace)
+{
+    auto profile = path.empty() ? cmsCreate_sRGBProfileTHR(ctx) : cmsOpenProfileFromFileTHR(ctx, path.c_str(), "r");
+    if (!profile) {
+        std::cerr << "Cannot open profile " << path << std::endl;
+        return nullptr;
+    }
+    if (cmsGetColorSpace(profile) != colorSpace) {
+        std::cerr << "Profile " << path << " has the wrong colorspace" << std::endl;
+        cmsCloseProfile(profile);
+        return nullptr;
+    }
+    return profile;
+}
+
+// The output pixel type and the bytes per sample.
+std::pair<cmsUInt32Number, size_t> outputType(OutputFormat format, const StreamInfo &info)
+{
+    switch (format) {
+    case OutputFormat::PFM:
+        return {TYPE_RGB_FLT, sizeof(cmsFloat32Number)};
+    case OutputFormat::Y4M:
+        return {info.sampleSize == 1 ? typeI444 : typeI410, info.sampleSize};
+    default:
+        // PAM stores 16-bit samples big endian.
+        if (info.sampleSize == 1) {
+            return {TYPE_RGB_8, 1};
+        }
+        return {littleEndian() ? TYPE_RGB_16_SE : TYPE_RGB_16, 2};
+    }
+}
+
+std::string streamHeader(OutputFormat format, const StreamInfo &info)
+{
+    if (format != OutputFormat::Y4M) {
+        return {};
+    }
+    std::string header = "YUV4MPEG2 W" + std::to_string(info.width) + " H" + std::to_string(info.height);
+    for (const auto &field : info.fields) {
+        header += " " + field;
+    }
+    return header + (info.sampleSize == 1 ? " C444\n" : " C444p10\n");
+}
+
+std::string frameHeader(OutputFormat format, const StreamInfo &info)
+{
+    switch (format) {
+    case OutputFormat::PAM:
+        return "P7\nWIDTH " + std::to_string(info.width) + "\nHEIGHT " + std::to_string(info.height) + "\nDEPTH 3\nMAXVAL "
+            + (info.sampleSize == 1 ? "255" : "65535") + "\nTUPLTYPE RGB\nENDHDR\n";
+    case OutputFormat::PFM:
+        // A negative scale marks little endian samples.
+        return "PF\n" + std::to_string(info.width) + " " + std::to_string(info.height) + (littleEndian() ? "\n-1.0\n" : "\n1.0\n");
+    default:
+        return "FRAME\n";
+    }
+}
+} // namespace
+
+int main(int argc, char **argv)
+{
+    Options options;
+    if (!parseOptions(argc, argv, options)) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    auto *input = openFile(options.input, false);
+    auto *output = openFile(options.output, true);
+    if (!input || !output) {
+        return 1;
+    }
+
+    StreamInfo info;
+    std::string line;
+    if (!readLine(input, line) || !parseHeader(line, info)) {
+        return 1;
+    }
+
+    cmsSetLogErrorHandlerTHR(nullptr, log);
+    auto ctx = cmsCreateContext(nullptr, nullptr);
+    cmsSetLogErrorHandlerTHR(ctx, log);
+    // The plugins registered last are looked up first, so the frame
+    // formatters take precedence over fast_float's.
+    if (!registerLcmsPlugins(ctx, options.lcmsPlugins) || !registerFormatters(ctx) || (options.plugin && !registerOptimization(ctx))) {
+        std::cerr << "Cannot register the plugins" << std::endl;
+        return 1;
+    }
+
+    const auto yCbCr = openProfile(ctx, options.profile, cmsSigYCbCrData);
+    const auto destination = openProfile(ctx, options.outputProfile, options.format == OutputFormat::Y4M ? cmsSigYCbCrData : cmsSigRgbData);
+    const auto type = outputType(options.format, info);
+    // Without the cache, the transform can run from several threads at once.
+    auto transform = yCbCr && destination ? cmsCreateTransformTHR(ctx, yCbCr, info.type, destination, type.first, INTENT_PERCEPTUAL, cmsFLAGS_NOCACHE) : nullptr;
+    if (yCbCr) {
+        cmsCloseProfile(yCbCr);
+    }
+    if (destination) {
+        cmsCloseProfile(destination);
+    }
+    if (!transform) {
+        cmsDeleteContext(ctx);
+        return 1;
+    }
+
+    // Y4M frames are written planar, everything else interleaved.
+    const auto bytesPerLine = info.width * type.second * (options.format == OutputFormat::Y4M ? 1 : 3);
+    const auto outputBytes = bytesPerLine * info.height * (options.format == OutputFormat::Y4M ? 3 : 1);
+    const auto header = frameHeader(options.format, info);
+    const auto stream = streamHeader(options.format, info);
+    if (!stream.empty() && std::fwrite(stream.data(), 1, stream.size(), output) != stream.size()) {
+        std::cerr << "Cannot write the stream header" << std::endl;
+        cmsDeleteTransform(transform);
+        cmsDeleteContext(ctx);
+        return 1;
+    }
+
+    // One frame being read, one transformed and one written.
+    std::array<Slot, 3> slots;
+    for (auto &slot : slots) {
+        slot.input.resize(info.lumaBytes() + 2 * info.chromaBytes());
+        slot.output.resize(outputBytes);
+    }
+
+    std::mutex mutex;
+    std::condition_variable changed;
+    size_t framesRead = 0;
+    size_t framesTransformed = 0;
+    size_t framesWritten = 0;
+    bool endOfInput = false;
+    bool endOfTransforms = false;
+    bool failed = false;
+    const auto fail = [&]() {
+        const std::lock_guard<std::mutex> lock(mutex);
+        failed = true;
+        changed.notify_all();
+    };
+
+    std::thread reader([&]() {
+        for (size_t k = 0;; k++) {
+            auto &slot = slots[k % slots.size()];
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                changed.wait(lock, [&]() {
+                    return failed || slot.state == Slot::State::Free;
+                });
+                if (failed) {
+                    return;
+                }
+            }
+            std::string frameLine;
+            if (!readLine(input, frameLine)) {
+                if (!frameLine.empty() || std::ferror(input)) {
+                    std::cerr << "Invalid frame header after frame " << k << std::endl;
+                    fail();
+                    return;
+                }
+                const std::lock_guard<std::mutex> lock(mutex);
+                endOfInput = true;
+                changed.notify_all();
+                return;
+            }
+            if (frameLine.compare(0, 5, "FRAME") != 0) {
+                std::cerr << "Invalid frame header after frame " << k << std::endl;
+                fail();
+                return;
+            }
+            if (std::fread(slot.input.data(), 1, slot.input.size(), input) != slot.input.size()) {
+                std::cerr << "Truncated frame " << k << std::endl;
+                fail();
+                return;
+            }
+            const std::lock_guard<std::mutex> lock(mutex);
+            slot.state = Slot::State::Decoded;
+            framesRead++;
+            changed.notify_all();
+        }
+    });
+
+    std::thread writer([&]() {
+        for (size_t k = 0;; k++) {
+            auto &slot = slots[k % slots.size()];
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                changed.wait(lock, [&]() {
+                    return failed || slot.state == Slot::State::Transformed || (endOfTransforms && framesTransformed == k);
+                });
+                if (failed || slot.state != Slot::State::Transformed) {
+                    return;
+                }
+            }
+            bool ok = std::fwrite(header.data(), 1, header.size(), output) == header.size();
+            if (options.format == OutputFormat::PFM) {
+                // PFM rows go from the bottom up.
+                for (size_t y = info.height; ok && y > 0; y--) {
+                    ok = std::fwrite(slot.output.data() + (y - 1) * bytesPerLine, 1, bytesPerLine, output) == bytesPerLine;
+                }
+            } else {
+                ok = ok && std::fwrite(slot.output.data(), 1, slot.output.size(), output) == slot.output.size();
+            }
+            if (!ok) {
+                std::cerr << "Cannot write frame " << k << std::endl;
+                fail();
+                return;
+            }
+            const std::lock_guard<std::mutex> lock(mutex);
+            slot.state = Slot::State::Free;
+            framesWritten++;
+            changed.notify_all();
+        }
+    });
+
+    // Bands of a few rows, several per thread so that they even out.
+    const auto rowsPerBand = std::max<size_t>(8, (info.height + options.jobs * 4 - 1) / (options.jobs * 4));
+    const auto bandCount = (info.height + rowsPerBand - 1) / rowsPerBand;
+    BandPool pool(options.jobs - 1);
+    clock::duration transformTime{};
+    const auto start = clock::now();
+    for (size_t k = 0;; k++) {
+        auto &slot = slots[k % slots.size()];
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            changed.wait(lock, [&]() {
+                return failed || slot.state == Slot::State::Decoded || (endOfInput && framesRead == k);
+            });
+            if (failed || slot.state != Slot::State::Decoded) {
+                break;
+            }
+        }
+        const auto frame = info.frame(slot.input.data());
+        std::atomic<bool> ok{true};
+        const auto transformStart = clock::now();
+        pool.run(bandCount, [&](size_t band) {
+            const auto first = band * rowsPerBand;
+            const auto rows = std::min(rowsPerBand, info.height - first);
+            if (!transformRows(transform, frame, slot.output.data(), bytesPerLine, static_cast<cmsUInt32Number>(first), static_cast<cmsUInt32Number>(rows))) {
+                ok = false;
+            }
+        });
+        transformTime += clock::now() - transformStart;
+        if (!ok) {
+            fail();
+            break;
+        }
+        const std::lock_guard<std::mutex> lock(mutex);
+        slot.state = Slot::State::Transformed;
+        framesTransformed++;
+        changed.notify_all();
+    }
+    {
+        const std::lock_guard<std::mutex> lock(mutex);
+        endOfTransforms = true;
+        changed.notify_all();
+    }
+    reader.join();
+    writer.join();
+    const std::chrono::duration<double> elapsed = clock::now() - start;
+    const std::chrono::duration<double> transforming = transformTime;
+
+    cmsDeleteTransform(transform);
+    cmsDeleteContext(ctx);
+    if (output != stdout) {
+        std::fclose(output);
+    } else {
+        std::fflush(output);
+    }
+    if (input != stdin) {
+        std::fclose(input);
+    }
+
+    std::cerr << std::fixed << std::setprecision(2) << framesWritten << " frames of " << info.width << "x" << info.height << " in " << elapsed.count() << " s";
+    if (framesWritten > 0) {
+        std::cerr << ": " << static_cast<double>(framesWritten) / elapsed.count() << " fps, "
+                  << static_cast<double>(framesTransformed) / transforming.count() << " fps transforming alone (" << options.jobs << " threads)";
+    }
+    std::cerr << std::endl;
+
+    return failed ? 1 : 0;
+}